@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "crc.hpp"
+
+using namespace tik;
+
+namespace
+{
+    template <typename F>
+    double measure(std::size_t bytes, F&& f)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return bytes / elapsed.count() / (1 << 20);
+    }
+
+    //Crcs of every BLOCK_SIZE block as crc encode computes them
+    template <const crc::Model& model>
+    bool run(std::vector<char>& input, std::uint64_t* bitset_sum = nullptr)
+    {
+        constexpr auto block = crc::BLOCK_SIZE;
+        std::uint64_t slice8_sum = 0;
+        const double slice8_speed = measure(input.size(), [&]()
+        {
+            for (std::size_t i = 0; i + block <= input.size(); i += block)
+                slice8_sum += crc::encode_span_sliced<model, 8>(std::span(input.data() + i, block));
+        });
+
+        std::uint64_t slice16_sum = 0;
+        const double slice16_speed = measure(input.size(), [&]()
+        {
+            for (std::size_t i = 0; i + block <= input.size(); i += block)
+                slice16_sum += crc::encode_span_sliced<model, 16>(std::span(input.data() + i, block));
+        });
+
+        std::uint64_t fast_sum = 0;
+        const double fast_speed = measure(input.size(), [&]()
+        {
+            for (std::size_t i = 0; i + block <= input.size(); i += block)
+                fast_sum += crc::encode_span_fast<model>(std::span(input.data() + i, block));
+        });
+
+        std::cout << model.name << "\n"
+                  << "  slicing-8:  " << slice8_speed << " MiB/s\n"
+                  << "  slicing-16: " << slice16_speed << " MiB/s\n"
+                  << "  dispatched: " << fast_speed << " MiB/s\n";
+        return slice8_sum == slice16_sum && slice8_sum == fast_sum
+            && (!bitset_sum || *bitset_sum == fast_sum);
+    }
+
+    template <const auto& poly>
+    std::uint64_t run_bitset(std::vector<char>& input)
+    {
+        constexpr auto block = crc::BLOCK_SIZE;
+        std::uint64_t sum = 0;
+        const double speed = measure(input.size(), [&]()
+        {
+            for (std::size_t i = 0; i + block <= input.size(); i += block)
+                sum += crc::encode_span<poly>(std::span(input.data() + i, block)).to_ulong();
+        });
+        std::cout << "bitset " << poly.size() << ": " << speed << " MiB/s\n";
+        return sum;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t size = argc > 1 ? std::stoull(argv[1]) : (64 << 20);
+    std::vector<char> input(size);
+    std::uint32_t state = 1;
+    for (auto& c : input)
+    {
+        state = state * 1664525 + 1013904223;
+        c = static_cast<char>(state >> 24);
+    }
+
+    std::uint64_t bitset16 = run_bitset<crc::CRC_16_ANSI>(input);
+    std::uint64_t bitset32 = run_bitset<crc::CRC_32>(input);
+    std::cout << "pclmul: " << crc::clmul::supported()
+              << ", sse4.2: " << crc::sse42::supported() << "\n";
+    if (!run<crc::TIK_16>(input, &bitset16)
+        || !run<crc::TIK_32>(input, &bitset32)
+        || !run<crc::CRC_16_ARC>(input)
+        || !run<crc::CRC_32_ISO_HDLC>(input)
+        || !run<crc::CRC_32_ISCSI>(input)
+        || !run<crc::CRC_64_XZ>(input))
+    {
+        std::cerr << "Crc mismatch\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <bit>
+#include "bit_buffer.hpp"
+#include "fse.hpp"
+#include "tree.hpp"
+#include "table_decoder.hpp"
+#include "table_encoder.hpp"
+
+using namespace tik;
+
+namespace
+{
+    //Mostly one byte with a skewed tail, where whole bit codes lose most
+    std::string make_input(std::size_t size, unsigned repeat)
+    {
+        std::string input;
+        input.reserve(size);
+        std::uint32_t state = 12345;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            state = state * 1664525 + 1013904223;
+            input.push_back(i % repeat ? 'a'
+                : static_cast<char>(std::countr_zero(state | 0x80000000u) * 7 + (state >> 29)));
+        }
+        return input;
+    }
+
+    template <typename F>
+    double measure(std::size_t bytes, F&& f)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return bytes / elapsed.count() / (1 << 20);
+    }
+
+    bool run(std::size_t size, unsigned repeat)
+    {
+        const std::string input = make_input(size, repeat);
+        const auto counts = CodeTree::count(input);
+
+        const auto lengths = CodeTree::build_huffman(counts, CodeTree::CodeType::CANONICAL).lengths();
+        const TableEncoder huffman_encoder(lengths);
+        const TableDecoder huffman_decoder(lengths);
+        std::vector<char> huffman(huffman_encoder.max_encoded_size(size));
+        std::size_t huffman_size = 0;
+        const double huffman_encode = measure(size, [&]()
+        {
+            utils::BufferBitWriter writer(huffman);
+            huffman_encoder.encode(input, writer);
+            huffman_size = writer.finish();
+        });
+        std::string huffman_result(size, '\0');
+        const double huffman_decode = measure(size, [&]()
+        {
+            huffman_decoder.decode(std::span<const char>(huffman).first(huffman_size), huffman_result);
+        });
+
+        const FseCoder coder(FseCoder::normalize(counts), FseCoder::DEFAULT_TABLE_LOG);
+        std::vector<char> fse(coder.max_encoded_size(size));
+        std::size_t fse_size = 0;
+        const double fse_encode = measure(size, [&]()
+        {
+            utils::BufferBitWriter writer(fse);
+            coder.encode(input, writer);
+            fse_size = writer.finish();
+        });
+        std::string fse_result(size, '\0');
+        const double fse_decode = measure(size, [&]()
+        {
+            coder.decode(std::span<const char>(fse).first(fse_size), fse_result);
+        });
+
+        std::cout << "input: " << size << " bytes, one random byte in " << repeat << "\n"
+                  << "huffman: " << huffman_size << " bytes, encode " << huffman_encode
+                  << " MiB/s, decode " << huffman_decode << " MiB/s\n"
+                  << "fse:     " << fse_size << " bytes, encode " << fse_encode
+                  << " MiB/s, decode " << fse_decode << " MiB/s\n";
+
+        return huffman_result == input && fse_result == input;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t size = argc > 1 ? std::stoull(argv[1]) : (32 << 20);
+    for (const unsigned repeat : {1, 4, 32})
+    {
+        if (!run(size, repeat))
+        {
+            std::cerr << "Decoded output mismatch\n";
+            return 1;
+        }
+    }
+    return 0;
+}
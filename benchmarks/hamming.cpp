@@ -0,0 +1,68 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "hamming.hpp"
+
+using namespace tik;
+
+namespace
+{
+    template <typename F>
+    double measure(std::size_t bytes, F&& f)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return bytes / elapsed.count() / (1 << 20);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    namespace fs = std::filesystem;
+    const std::size_t size = argc > 1 ? std::stoull(argv[1]) : (64 << 20);
+    const auto dir = fs::temp_directory_path() / ("tik_bench_hamming_" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+
+    std::vector<char> input(size);
+    std::uint32_t state = 1;
+    for (auto& c : input)
+    {
+        state = state * 1664525 + 1013904223;
+        c = static_cast<char>(state >> 24);
+    }
+    std::ofstream(dir / "input", std::ios::binary).write(input.data(), input.size());
+
+    const double encode_speed = measure(size, [&]()
+    {
+        hamming::encode(dir / "input", dir / "encoded");
+    });
+    const double decode_speed = measure(size, [&]()
+    {
+        hamming::decode(dir / "encoded", dir / "decoded");
+    });
+    std::ostringstream log;
+    const double check_speed = measure(size, [&]()
+    {
+        hamming::check(dir / "encoded", log);
+    });
+
+    std::cout << "encode: " << encode_speed << " MiB/s\n"
+              << "decode: " << decode_speed << " MiB/s\n"
+              << "check:  " << check_speed << " MiB/s\n";
+
+    std::ifstream decoded(dir / "decoded", std::ios::binary);
+    const bool same = std::equal(input.begin(), input.end(), std::istreambuf_iterator<char>(decoded));
+    fs::remove_all(dir);
+    if (!same)
+    {
+        std::cerr << "Round trip mismatch\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include "histogram.hpp"
+
+using namespace tik;
+
+namespace
+{
+    template <typename F>
+    double measure(std::size_t bytes, F&& f)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return bytes / elapsed.count() / (1 << 20);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t size = argc > 1 ? std::stoull(argv[1]) : (64 << 20);
+    const unsigned threads = argc > 2 ? std::stoul(argv[2]) : 4;
+
+    //Long runs of equal bytes are the worst case for a single table
+    std::string input(size, '\0');
+    std::uint32_t state = 1;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (i % 64 == 0)
+            state = state * 1664525 + 1013904223;
+        input[i] = static_cast<char>(state >> 28);
+    }
+
+    std::map<char, unsigned> map_counts;
+    const double map_speed = measure(size, [&]()
+    {
+        for (const char c : input)
+            ++map_counts[c];
+    });
+
+    utils::Histogram single;
+    const double single_speed = measure(size, [&]() { single = utils::histogram(input); });
+
+    utils::Histogram parallel;
+    const double parallel_speed = measure(size, [&]() { parallel = utils::histogram(input, threads); });
+
+    std::cout << "std::map:           " << map_speed << " MiB/s\n"
+              << "histogram:          " << single_speed << " MiB/s\n"
+              << "histogram " << threads << " threads: " << parallel_speed << " MiB/s\n";
+
+    for (const auto& [c, n] : map_counts)
+    {
+        if (single[static_cast<unsigned char>(c)] != n || parallel[static_cast<unsigned char>(c)] != n)
+        {
+            std::cerr << "Count mismatch\n";
+            return 1;
+        }
+    }
+    return 0;
+}
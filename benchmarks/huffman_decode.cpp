@@ -0,0 +1,113 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <array>
+#include <bit>
+#include <vector>
+#include "bit_buffer.hpp"
+#include "tree.hpp"
+#include "table_decoder.hpp"
+#include "table_encoder.hpp"
+
+using namespace tik;
+
+namespace
+{
+    std::string make_input(std::size_t size)
+    {
+        std::string input;
+        input.reserve(size);
+        std::uint32_t state = 12345;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            state = state * 1664525 + 1013904223;
+            input.push_back(static_cast<char>(std::countr_zero(state | 0x80000000u) * 7 + (state >> 29)));
+        }
+        return input;
+    }
+
+    template <typename F>
+    double measure(std::size_t bytes, F&& f)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return bytes / elapsed.count() / (1 << 20);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t size = argc > 1 ? std::stoull(argv[1]) : (32 << 20);
+    const std::string input = make_input(size);
+
+    std::istringstream is(input);
+    auto tree = CodeTree::build_huffman(is);
+
+    is = std::istringstream(input);
+    std::ostringstream encoded_stream;
+    tree.encode(is, encoded_stream);
+    const std::string encoded = encoded_stream.str();
+
+    std::string tree_result;
+    const double tree_speed = measure(size, [&]()
+    {
+        std::istringstream in(encoded);
+        std::ostringstream out;
+        tree.decode_tree_walk(in, out, size);
+        tree_result = out.str();
+    });
+
+    std::string table_result;
+    const double table_speed = measure(size, [&]()
+    {
+        std::istringstream in(encoded);
+        std::ostringstream out;
+        tree.decode(in, out, size);
+        table_result = out.str();
+    });
+
+    std::string span_result(size, '\0');
+    const TableDecoder decoder(tree.codes());
+    const double span_speed = measure(size, [&]()
+    {
+        decoder.decode(encoded, span_result);
+    });
+
+    //The whole input as one interleaved block
+    constexpr unsigned STREAMS = TableDecoder::STREAMS;
+    const TableEncoder encoder(tree.codes());
+    const std::size_t segment = TableDecoder::segment_size(size);
+    std::array<std::vector<char>, STREAMS> streams;
+    std::array<std::span<const char>, STREAMS> stream_spans;
+    for (unsigned s = 0; s < STREAMS; ++s)
+    {
+        const std::size_t begin = std::min(s * segment, size);
+        const auto part = std::span<const char>(input).subspan(begin, std::min(segment, size - begin));
+        streams[s].resize(encoder.max_encoded_size(part.size()));
+        utils::BufferBitWriter writer(streams[s]);
+        encoder.encode(part, writer);
+        stream_spans[s] = std::span<const char>(streams[s]).first(writer.finish());
+    }
+
+    std::string interleaved_result(size, '\0');
+    const double interleaved_speed = measure(size, [&]()
+    {
+        decoder.decode_interleaved(stream_spans, interleaved_result);
+    });
+
+    std::cout << "input: " << size << " bytes, encoded: " << encoded.size() << " bytes\n"
+              << "tree walk: " << tree_speed << " MiB/s\n"
+              << "table:     " << table_speed << " MiB/s\n"
+              << "table span: " << span_speed << " MiB/s\n"
+              << "interleaved: " << interleaved_speed << " MiB/s\n";
+
+    if (tree_result != input || table_result != input || span_result != input
+        || interleaved_result != input)
+    {
+        std::cerr << "Decoded output mismatch\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <bit>
+#include "bit_buffer.hpp"
+#include "bit_writer.hpp"
+#include "tree.hpp"
+#include "table_encoder.hpp"
+
+using namespace tik;
+
+namespace
+{
+    std::string make_input(std::size_t size)
+    {
+        std::string input;
+        input.reserve(size);
+        std::uint32_t state = 12345;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            state = state * 1664525 + 1013904223;
+            input.push_back(static_cast<char>(std::countr_zero(state | 0x80000000u) * 7 + (state >> 29)));
+        }
+        return input;
+    }
+
+    template <typename F>
+    double measure(std::size_t bytes, F&& f)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return bytes / elapsed.count() / (1 << 20);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t size = argc > 1 ? std::stoull(argv[1]) : (32 << 20);
+    const std::string input = make_input(size);
+
+    std::istringstream is(input);
+    const auto tree = CodeTree::build_huffman(is);
+
+    std::string writer_result;
+    const double writer_speed = measure(size, [&]()
+    {
+        std::ostringstream out;
+        {
+            utils::BitWriter writer(out);
+            for (const char c : input)
+            {
+                const auto& code = tree.map_char(c);
+                writer.write(code.value, code.length);
+            }
+        }
+        writer_result = out.str();
+    });
+
+    const TableEncoder encoder(tree.codes());
+    std::vector<char> buffer(encoder.max_encoded_size(size));
+    std::size_t table_size = 0;
+    const double table_speed = measure(size, [&]()
+    {
+        utils::BufferBitWriter writer(buffer);
+        encoder.encode(input, writer);
+        table_size = writer.finish();
+    });
+
+    std::cout << "input: " << size << " bytes, encoded: " << table_size << " bytes\n"
+              << "bit writer: " << writer_speed << " MiB/s\n"
+              << "table:      " << table_speed << " MiB/s\n";
+
+    if (writer_result != std::string(buffer.data(), table_size))
+    {
+        std::cerr << "Encoded output mismatch\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,15 +1,17 @@
 #include <iostream>
 #include <boost/program_options.hpp>
 #include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include "crc.hpp"
 
-constexpr auto POLY = tik::crc::CRC_16_ANSI;
-
 enum class ExecutionMode
 {
     ENCODE,
     DECODE,
-    CHECK
+    CHECK,
+    UPDATE
 };
 
 std::istream& operator>>(std::istream& in, ExecutionMode& mode)
@@ -22,11 +24,26 @@ std::istream& operator>>(std::istream& in, ExecutionMode& mode)
         mode = ExecutionMode::DECODE;
     else if (str == "check")
         mode = ExecutionMode::CHECK;
+    else if (str == "update")
+        mode = ExecutionMode::UPDATE;
     else
         in.setstate(in.rdstate() | std::ios::failbit);
     return in;
 }
 
+unsigned threads(unsigned requested)
+{
+    return requested ? requested : std::thread::hardware_concurrency();
+}
+
+std::string model_names()
+{
+    std::string result;
+    for (const auto* model : tik::crc::CATALOGUE)
+        result += (result.empty() ? "" : ", ") + std::string(model->name);
+    return result;
+}
+
 int main(int argc, char** argv)
 {
     namespace po = boost::program_options;
@@ -39,7 +56,7 @@ int main(int argc, char** argv)
         ("help", "Produce help message")
         ("fname", po::value<std::string>()->required(), "Input file to encode")
         ("mode", po::value(&mode)->required(),
-         "Mode of executable [encode, decode, flip, check]")
+         "Mode of executable [encode, decode, flip, check, update]")
         ("subargs", po::value<std::vector<std::string>>(), "Arguments for command");
 
     po::positional_options_description positional;
@@ -75,7 +92,12 @@ int main(int argc, char** argv)
     {
         po::options_description encode_options("encode options");
         encode_options.add_options()
-            ("suffix", po::value<std::string>()->default_value(".crc"), "Output file suffix");
+            ("suffix", po::value<std::string>()->default_value(".crc"), "Output file suffix")
+            ("poly", po::value<std::string>()->default_value("tik-16"),
+             ("Crc model [" + model_names() + "]").c_str())
+            ("block-size", po::value<std::size_t>()->default_value(tik::crc::BLOCK_SIZE),
+             "Block size in bytes, crc included")
+            ("threads", po::value<unsigned>()->default_value(1), "Encode blocks on N threads (0 - all cores)");
         po::store(po::command_line_parser(opts).options(encode_options).run(), vm);
 
         if (vm.count("help"))
@@ -88,14 +110,37 @@ int main(int argc, char** argv)
         fs::path out_path(input_file);
         const std::string suffix = vm["suffix"].as<std::string>();
 
-        tik::crc::encode<POLY>(input_file, out_path.concat(suffix));
+        const auto model = tik::crc::find_model(vm["poly"].as<std::string>());
+        if (!model)
+        {
+            std::cerr << "Unknown crc model, available: " << model_names() << "\n";
+            return 1;
+        }
+
+        tik::crc::Options options;
+        options.model = *model;
+        options.block_size = vm["block-size"].as<std::size_t>();
+        options.threads = threads(vm["threads"].as<unsigned>());
+        try
+        {
+            const auto crc = tik::crc::encode(input_file, out_path.concat(suffix), options);
+            std::cout << "File crc: " << crc << "\n";
+        }
+        catch (const std::invalid_argument& error)
+        {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
         break;
     }
     case ExecutionMode::DECODE:
     {
         po::options_description decode_options("decode options");
         decode_options.add_options()
-            ("suffix", po::value<std::string>()->default_value(".decoded"));
+            ("suffix", po::value<std::string>()->default_value(".decoded"))
+            ("threads", po::value<unsigned>()->default_value(1), "Decode blocks on N threads (0 - all cores)")
+            ("abort", "Stop at the first block that fails")
+            ("repair", "Fix blocks with a single bit error");
         po::store(po::command_line_parser(opts).options(decode_options).run(), vm);
 
         if (vm.count("help"))
@@ -108,11 +153,104 @@ int main(int argc, char** argv)
         fs::path out_path(input_file);
         const std::string suffix = vm["suffix"].as<std::string>();
 
+        tik::crc::DecodeOptions options;
+        options.threads = threads(vm["threads"].as<unsigned>());
+        options.abort = vm.count("abort");
+        options.repair = vm.count("repair");
+        try
+        {
+            const auto result = tik::crc::decode(input_file, out_path.concat(suffix), std::cout, options);
+            std::cout << "Failed blocks: " << result.failed << ", repaired: " << result.repaired << "\n"
+                      << "File crc: " << result.crc << "\n";
+            if (result.failed)
+                return 1;
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
         break;
     }
     case ExecutionMode::CHECK:
     {
-        tik::crc::check<POLY>(input_file, std::cout);
+        po::options_description check_options("check options");
+        check_options.add_options()
+            ("threads", po::value<unsigned>()->default_value(1), "Check blocks on N threads (0 - all cores)");
+        po::store(po::command_line_parser(opts).options(check_options).run(), vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << check_options << "\n";
+            return 1;
+        }
+        vm.notify();
+
+        try
+        {
+            const auto crc = tik::crc::check(input_file, std::cout, threads(vm["threads"].as<unsigned>()));
+            std::cout << "File crc: " << crc << "\n";
+        }
+        catch (const std::invalid_argument& error)
+        {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        break;
+    }
+    case ExecutionMode::UPDATE:
+    {
+        po::options_description update_options("update options");
+        update_options.add_options()
+            ("suffix", po::value<std::string>()->default_value(".crc"), "Suffix of the encoded file")
+            ("range", po::value<std::vector<std::string>>(),
+             "Changed bytes as offset:size, the encoded file is compared when none is given");
+        po::store(po::command_line_parser(opts).options(update_options).run(), vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << update_options << "\n";
+            return 1;
+        }
+        vm.notify();
+
+        std::vector<tik::crc::Range> ranges;
+        if (vm.count("range"))
+        {
+            for (const auto& range : vm["range"].as<std::vector<std::string>>())
+            {
+                const auto colon = range.find(':');
+                try
+                {
+                    //stoull also takes a sign and wraps negative values
+                    if (colon == std::string::npos || range.find_first_of("+-") != std::string::npos)
+                        throw std::invalid_argument("not offset:size");
+                    std::size_t used;
+                    const std::uint64_t offset = std::stoull(range.substr(0, colon), &used);
+                    if (used != colon)
+                        throw std::invalid_argument("bad offset");
+                    const std::uint64_t size = std::stoull(range.substr(colon + 1), &used);
+                    if (used != range.size() - colon - 1)
+                        throw std::invalid_argument("bad size");
+                    ranges.push_back({offset, size});
+                }
+                catch (const std::exception&)
+                {
+                    std::cerr << "Range " << range << " is not offset:size\n";
+                    return 1;
+                }
+            }
+        }
+
+        fs::path encoded_path(input_file);
+        encoded_path.concat(vm["suffix"].as<std::string>());
+        if (!fs::exists(encoded_path))
+        {
+            std::cerr << "File " << encoded_path.string() << " do not exists\n";
+            return 1;
+        }
+
+        std::cout << "Rewritten blocks: " << tik::crc::update(input_file, encoded_path, ranges) << "\n";
         break;
     }
     }
@@ -1,8 +1,11 @@
 #include <boost/program_options.hpp>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include "tik.hpp"
-#include <filesystem>
 
 int main(int argc, char** argv)
 {
@@ -11,11 +14,15 @@ int main(int argc, char** argv)
     po::options_description visible;
 
     visible.add_options()
-        ("help", "Produce help message");
+        ("help", "Produce help message")
+        ("threads", po::value<unsigned>()->default_value(1),
+         "Decode chunks on N threads (0 - all cores)")
+        ("range", po::value<std::string>(),
+         "Decode only LENGTH bytes from OFFSET given as OFFSET:LENGTH, needs an indexed or chunked file");
 
     po::options_description hidden;
     hidden.add_options()
-        ("fname", po::value<std::string>()->required(), "Input file to decode");
+        ("fname", po::value<std::string>()->required(), "Input file to decode, - to decode stdin to stdout");
     po::positional_options_description positional;
     positional.add("fname", 1);
 
@@ -32,7 +39,18 @@ int main(int argc, char** argv)
     }
     po::notify(vm);
 
+    unsigned threads = vm["threads"].as<unsigned>();
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+
     fs::path inputFile(vm["fname"].as<std::string>());
+    if (inputFile == "-")
+    {
+        std::ios::sync_with_stdio(false);
+        tik::decode(std::cin, std::cout, threads);
+        return 0;
+    }
+
     if (!fs::exists(inputFile))
     {
         std::cerr << "File " << inputFile.string() << " do not exists\n";
@@ -40,8 +58,36 @@ int main(int argc, char** argv)
     }
 
     fs::path out_path(inputFile);
+    out_path.concat(".decoded");
+
+    if (vm.count("range"))
+    {
+        const std::string range = vm["range"].as<std::string>();
+        const auto separator = range.find(':');
+        try
+        {
+            if (separator == std::string::npos)
+                throw std::invalid_argument("Range must be OFFSET:LENGTH");
+            std::size_t used;
+            const std::uint64_t offset = std::stoull(range.substr(0, separator), &used);
+            if (used != separator)
+                throw std::invalid_argument("Range must be OFFSET:LENGTH");
+            const std::uint64_t length = std::stoull(range.substr(separator + 1), &used);
+            if (used != range.size() - separator - 1)
+                throw std::invalid_argument("Range must be OFFSET:LENGTH");
+
+            std::ofstream out(out_path, std::ios::binary);
+            tik::decode_range(inputFile, out, offset, length);
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
 
-    tik::decode(inputFile, out_path.concat(".decoded"));
+    tik::decode(inputFile, out_path, threads);
 
     return 0;
 }
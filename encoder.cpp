@@ -1,6 +1,8 @@
 #include <boost/program_options.hpp>
 #include <iostream>
 #include <filesystem>
+#include <stdexcept>
+#include <thread>
 #include "tik.hpp"
 
 
@@ -13,11 +15,22 @@ int main(int argc, char** argv)
     visible.add_options()
         ("help", "Produce help message")
         ("shannon-fano", "Encode using Shannon-Fano Algorithm")
+        ("fse", "Encode using finite state entropy (tANS) coding")
+        ("canonical", "Use canonical codes, only code lengths are stored")
+        ("max-code-length", po::value<unsigned>()->default_value(tik::CodeTree::MAX_CANONICAL_LENGTH),
+         "Maximal Huffman code length [8, 32]")
+        ("threads", po::value<unsigned>(),
+         "Encode chunks on N threads (0 - all cores), implies chunked format")
+        ("chunk-size", po::value<std::size_t>(),
+         "Bytes per independently coded chunk, implies chunked format")
+        ("interleaved", "Split blocks into 4 code streams decoded side by side")
+        ("index-interval", po::value<std::size_t>(),
+         "Checkpoint every N bytes so decoder --range reads only part of the file")
         ("suffix", po::value<std::string>()->default_value(".encoded"));
 
     po::options_description hidden;
     hidden.add_options()
-        ("fname", po::value<std::string>()->required(), "Input file to encode");
+        ("fname", po::value<std::string>()->required(), "Input file to encode, - to encode stdin to stdout");
     po::positional_options_description positional;
     positional.add("fname", 1);
 
@@ -35,22 +48,102 @@ int main(int argc, char** argv)
     po::notify(vm);
 
     fs::path inputFile(vm["fname"].as<std::string>());
+    std::string suffix = vm["suffix"].as<std::string>();
+
+    tik::EncodeOptions options;
+    if (vm.count("canonical"))
+        options.code_type = tik::CodeTree::CodeType::CANONICAL;
 
-    if (!fs::exists(inputFile))
+    options.max_code_length = vm["max-code-length"].as<unsigned>();
+    if (options.max_code_length < 8
+        || options.max_code_length > tik::CodeTree::MAX_CANONICAL_LENGTH)
     {
-        std::cerr << "File " << inputFile.string() << " do not exists\n";
+        std::cerr << "Maximal code length must be in range [8, 32]\n";
         return 1;
     }
 
-    std::string suffix = vm["suffix"].as<std::string>();
+    const bool fse = vm.count("fse");
+    if (fse && (vm.count("shannon-fano") || vm.count("canonical") || vm.count("interleaved")))
+    {
+        std::cerr << "FSE can not be combined with prefix code options\n";
+        return 1;
+    }
+
+    if (vm.count("threads") || vm.count("chunk-size"))
+    {
+        options.chunk_size = vm.count("chunk-size")
+            ? vm["chunk-size"].as<std::size_t>() : tik::DEFAULT_CHUNK_SIZE;
+        options.threads = vm.count("threads") ? vm["threads"].as<unsigned>() : 1;
+        if (options.threads == 0)
+            options.threads = std::thread::hardware_concurrency();
 
-    if (vm.count("shannon-fano"))
+        if (options.chunk_size == 0)
+        {
+            std::cerr << "Chunk size must be positive\n";
+            return 1;
+        }
+    }
+
+    if (vm.count("interleaved"))
     {
-        tik::encode_shannon_fano(inputFile, fs::path(inputFile).concat(suffix));
+        if (options.chunk_size || inputFile == "-")
+        {
+            std::cerr << "Interleaved streams can not be chunked or streamed\n";
+            return 1;
+        }
+        options.interleaved = true;
     }
-    else
+
+    if (vm.count("index-interval"))
     {
-        tik::encode_huffman(inputFile, fs::path(inputFile).concat(suffix));
+        options.index_interval = vm["index-interval"].as<std::size_t>();
+        if (options.index_interval == 0)
+        {
+            std::cerr << "Index interval must be positive\n";
+            return 1;
+        }
+        if (fse || options.chunk_size || options.interleaved || inputFile == "-")
+        {
+            std::cerr << "Index can not be combined with FSE, chunks, interleaving or streaming\n";
+            return 1;
+        }
+    }
+
+    if (inputFile != "-" && !fs::exists(inputFile))
+    {
+        std::cerr << "File " << inputFile.string() << " do not exists\n";
+        return 1;
+    }
+
+    try
+    {
+        if (inputFile == "-")
+        {
+            std::ios::sync_with_stdio(false);
+            if (fse)
+                tik::encode_fse(std::cin, std::cout, options);
+            else if (vm.count("shannon-fano"))
+                tik::encode_shannon_fano(std::cin, std::cout, options);
+            else
+                tik::encode_huffman(std::cin, std::cout, options);
+        }
+        else if (fse)
+        {
+            tik::encode_fse(inputFile, fs::path(inputFile).concat(suffix), options);
+        }
+        else if (vm.count("shannon-fano"))
+        {
+            tik::encode_shannon_fano(inputFile, fs::path(inputFile).concat(suffix), options);
+        }
+        else
+        {
+            tik::encode_huffman(inputFile, fs::path(inputFile).concat(suffix), options);
+        }
+    }
+    catch (const std::invalid_argument& error)
+    {
+        std::cerr << error.what() << "\n";
+        return 1;
     }
 
     return 0;
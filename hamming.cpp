@@ -4,6 +4,8 @@
 #include <fstream>
 #include <filesystem>
 #include <iterator>
+#include <thread>
+#include <optional>
 #include "tik.hpp"
 #include "utils.hpp"
 #include "hamming.hpp"
@@ -13,7 +15,8 @@ enum class ExecutionMode
     ENCODE,
     DECODE,
     FLIP,
-    CHECK
+    CHECK,
+    REPAIR
 };
 
 std::istream& operator>>(std::istream& in, ExecutionMode& mode)
@@ -28,11 +31,33 @@ std::istream& operator>>(std::istream& in, ExecutionMode& mode)
         mode = ExecutionMode::FLIP;
     else if (str == "check")
         mode = ExecutionMode::CHECK;
+    else if (str == "repair")
+        mode = ExecutionMode::REPAIR;
     else
         in.setstate(in.rdstate() | std::ios::failbit);
     return in;
 }
 
+unsigned threads(unsigned requested)
+{
+    return requested ? requested : std::thread::hardware_concurrency();
+}
+
+//Code names as they are given to encode --code
+std::optional<tik::hamming::Type> find_type(const std::string& name)
+{
+    using tik::hamming::Type;
+    if (name == "15-11")
+        return Type::NORMAL;
+    if (name == "16-11")
+        return Type::EXTENDED;
+    if (name == "39-32")
+        return Type::SECDED_39_32;
+    if (name == "72-64")
+        return Type::SECDED_72_64;
+    return std::nullopt;
+}
+
 int main(int argc, char** argv)
 {
     namespace po = boost::program_options;
@@ -45,7 +70,7 @@ int main(int argc, char** argv)
         ("help", "Produce help message")
         ("fname", po::value<std::string>()->required(), "Input file to encode")
         ("mode", po::value(&mode)->required(),
-         "Mode of executable [encode, decode, flip, check]")
+         "Mode of executable [encode, decode, flip, check, repair]")
         ("subargs", po::value<std::vector<std::string>>(), "Arguments for command");
 
     po::positional_options_description positional;
@@ -82,7 +107,10 @@ int main(int argc, char** argv)
         po::options_description encode_options("encode options");
         encode_options.add_options()
             ("suffix", po::value<std::string>()->default_value(".hamming"), "Output file suffix")
-            ("no-extended", "Use (15, 11) hamming");
+            ("code", po::value<std::string>()->default_value("16-11"),
+             "Hamming code [15-11, 16-11, 39-32, 72-64]")
+            ("no-extended", "Use (15, 11) hamming, same as --code 15-11")
+            ("threads", po::value<unsigned>()->default_value(1), "Encode blocks on N threads (0 - all cores)");
         po::store(po::command_line_parser(opts).options(encode_options).run(), vm);
 
         if (vm.count("help"))
@@ -94,10 +122,17 @@ int main(int argc, char** argv)
 
         fs::path out_path(input_file);
         const std::string suffix = vm["suffix"].as<std::string>();
+        auto type = find_type(vm["code"].as<std::string>());
+        if (!type)
+        {
+            std::cerr << "Unknown code, available: 15-11, 16-11, 39-32, 72-64\n";
+            return 1;
+        }
         if (vm.count("no-extended"))
-            tik::hamming::encode_not_extended(input_file, out_path.concat(suffix));
-        else
-            tik::hamming::encode(input_file, out_path.concat(suffix));
+            type = tik::hamming::Type::NORMAL;
+
+        tik::hamming::encode(input_file, out_path.concat(suffix), *type,
+                             threads(vm["threads"].as<unsigned>()));
 
         break;
     }
@@ -105,7 +140,8 @@ int main(int argc, char** argv)
     {
         po::options_description decode_options("decode options");
         decode_options.add_options()
-            ("suffix", po::value<std::string>()->default_value(".decoded"));
+            ("suffix", po::value<std::string>()->default_value(".decoded"))
+            ("threads", po::value<unsigned>()->default_value(1), "Decode blocks on N threads (0 - all cores)");
         po::store(po::command_line_parser(opts).options(decode_options).run(), vm);
 
         if (vm.count("help"))
@@ -117,7 +153,8 @@ int main(int argc, char** argv)
 
         fs::path out_path(input_file);
         const std::string suffix = vm["suffix"].as<std::string>();
-        tik::hamming::decode(input_file, out_path.concat(suffix));
+        tik::hamming::decode(input_file, out_path.concat(suffix),
+                             threads(vm["threads"].as<unsigned>()));
         break;
     }
     case ExecutionMode::FLIP:
@@ -160,7 +197,38 @@ int main(int argc, char** argv)
     }
     case ExecutionMode::CHECK:
     {
-        tik::hamming::check(input_file, std::cout);
+        po::options_description check_options("check options");
+        check_options.add_options()
+            ("threads", po::value<unsigned>()->default_value(1), "Check blocks on N threads (0 - all cores)");
+        po::store(po::command_line_parser(opts).options(check_options).run(), vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << check_options << "\n";
+            return 1;
+        }
+        vm.notify();
+
+        tik::hamming::check(input_file, std::cout, threads(vm["threads"].as<unsigned>()));
+        break;
+    }
+    case ExecutionMode::REPAIR:
+    {
+        try
+        {
+            const auto result = tik::hamming::repair(input_file);
+            for (const auto offset : result.double_errors)
+                std::cout << "Double error at offset " << offset << "\n";
+            std::cout << "Repaired codewords: " << result.repaired
+                      << ", double errors: " << result.double_errors.size() << "\n";
+            if (!result.double_errors.empty())
+                return 1;
+        }
+        catch (const std::invalid_argument& error)
+        {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
         break;
     }
     }
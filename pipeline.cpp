@@ -0,0 +1,192 @@
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include "pipeline.hpp"
+
+enum class ExecutionMode
+{
+    PROTECT,
+    RESTORE
+};
+
+std::istream& operator>>(std::istream& in, ExecutionMode& mode)
+{
+    std::string str;
+    in >> str;
+    if (str == "protect")
+        mode = ExecutionMode::PROTECT;
+    else if (str == "restore")
+        mode = ExecutionMode::RESTORE;
+    else
+        in.setstate(in.rdstate() | std::ios::failbit);
+    return in;
+}
+
+unsigned threads(unsigned requested)
+{
+    return requested ? requested : std::thread::hardware_concurrency();
+}
+
+std::string model_names()
+{
+    std::string result;
+    for (const auto* model : tik::crc::CATALOGUE)
+        result += (result.empty() ? "" : ", ") + std::string(model->name);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    namespace po = boost::program_options;
+    namespace fs = std::filesystem;
+
+    ExecutionMode mode;
+
+    po::options_description visible;
+    visible.add_options()
+        ("help", "Produce help message")
+        ("fname", po::value<std::string>()->required(), "Input file")
+        ("mode", po::value(&mode)->required(),
+         "Mode of executable [protect, restore]")
+        ("subargs", po::value<std::vector<std::string>>(), "Arguments for command");
+
+    po::positional_options_description positional;
+    positional.add("mode", 1);
+    positional.add("fname", 1);
+    positional.add("subargs", -1);
+
+    po::variables_map vm;
+    po::parsed_options parsed = po::command_line_parser(argc, argv).options(visible)
+        .positional(positional).allow_unregistered().run();
+    po::store(parsed, vm);
+
+    if (vm.count("help")) {
+        std::cout << visible << "\n";
+        return 1;
+    }
+    po::notify(vm);
+
+    fs::path input_file(vm["fname"].as<std::string>());
+
+    if (!fs::exists(input_file))
+    {
+        std::cerr << "File " << input_file.string() << " do not exists\n";
+        return 1;
+    }
+
+    std::vector<std::string> opts = po::collect_unrecognized(parsed.options, po::include_positional);
+    opts.erase(opts.begin(), opts.begin() + 2);
+
+    switch (mode)
+    {
+    case ExecutionMode::PROTECT:
+    {
+        po::options_description protect_options("protect options");
+        protect_options.add_options()
+            ("suffix", po::value<std::string>()->default_value(".protected"), "Output file suffix")
+            ("shannon-fano", "Compress using Shannon-Fano Algorithm")
+            ("fse", "Compress using finite state entropy (tANS) coding")
+            ("poly", po::value<std::string>()->default_value("tik-16"),
+             ("Crc model [" + model_names() + "]").c_str())
+            ("block-size", po::value<std::size_t>()->default_value(tik::crc::BLOCK_SIZE),
+             "Crc block size in bytes, crc included")
+            ("code", po::value<std::string>()->default_value("72-64"), "Hamming code [39-32, 72-64]")
+            ("threads", po::value<unsigned>()->default_value(1), "Threads of every stage (0 - all cores)");
+        po::store(po::command_line_parser(opts).options(protect_options).run(), vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << protect_options << "\n";
+            return 1;
+        }
+        vm.notify();
+
+        tik::pipeline::Options options;
+        if (vm.count("fse"))
+            options.compression = tik::pipeline::Compression::FSE;
+        else if (vm.count("shannon-fano"))
+            options.compression = tik::pipeline::Compression::SHANNON_FANO;
+
+        const auto model = tik::crc::find_model(vm["poly"].as<std::string>());
+        if (!model)
+        {
+            std::cerr << "Unknown crc model, available: " << model_names() << "\n";
+            return 1;
+        }
+        options.crc.model = *model;
+        options.crc.block_size = vm["block-size"].as<std::size_t>();
+
+        const std::string code = vm["code"].as<std::string>();
+        if (code == "39-32")
+            options.hamming = tik::hamming::Type::SECDED_39_32;
+        else if (code != "72-64")
+        {
+            std::cerr << "Unknown code, available: 39-32, 72-64\n";
+            return 1;
+        }
+
+        const unsigned stage_threads = threads(vm["threads"].as<unsigned>());
+        options.encode.threads = stage_threads;
+        options.crc.threads = stage_threads;
+        options.hamming_threads = stage_threads;
+
+        fs::path out_path(input_file);
+        try
+        {
+            const auto crc = tik::pipeline::protect(input_file, out_path.concat(vm["suffix"].as<std::string>()),
+                                                    options);
+            std::cout << "Compressed crc: " << crc << "\n";
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        break;
+    }
+    case ExecutionMode::RESTORE:
+    {
+        po::options_description restore_options("restore options");
+        restore_options.add_options()
+            ("suffix", po::value<std::string>()->default_value(".restored"))
+            ("threads", po::value<unsigned>()->default_value(1), "Threads of every stage (0 - all cores)")
+            ("repair", "Fix crc blocks with a single bit error");
+        po::store(po::command_line_parser(opts).options(restore_options).run(), vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << restore_options << "\n";
+            return 1;
+        }
+        vm.notify();
+
+        tik::pipeline::RestoreOptions options;
+        const unsigned stage_threads = threads(vm["threads"].as<unsigned>());
+        options.crc.threads = stage_threads;
+        options.crc.repair = vm.count("repair");
+        options.hamming_threads = stage_threads;
+        options.decode_threads = stage_threads;
+
+        fs::path out_path(input_file);
+        try
+        {
+            const auto result = tik::pipeline::restore(input_file, out_path.concat(vm["suffix"].as<std::string>()),
+                                                       std::cout, options);
+            std::cout << "Failed blocks: " << result.failed << ", repaired: " << result.repaired << "\n"
+                      << "Compressed crc: " << result.crc << "\n";
+            if (result.failed)
+                return 1;
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        break;
+    }
+    }
+
+    return 0;
+}
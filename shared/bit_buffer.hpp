@@ -0,0 +1,245 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "utils.hpp"
+
+namespace tik
+{
+    namespace utils
+    {
+        inline std::uint64_t load_u64_le(const char* data)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            if constexpr (std::endian::native == std::endian::big)
+                word = swap_endian(word);
+            return word;
+        }
+
+        inline void store_u64_le(char* data, std::uint64_t word)
+        {
+            if constexpr (std::endian::native == std::endian::big)
+                word = swap_endian(word);
+            std::memcpy(data, &word, sizeof(word));
+        }
+
+        //Reads bits in BitGetter order (lowest bit of a byte first) from a
+        //buffer through a 64 bit accumulator. Past the end of the buffer
+        //zero bits are supplied
+        class BufferBitReader
+        {
+        public:
+            explicit BufferBitReader(std::span<const char> in)
+                : m_in(in)
+            {}
+
+            //Guarantees at least 56 bits available for peek
+            void refill()
+            {
+                if (m_pos + sizeof(std::uint64_t) <= m_in.size())
+                {
+                    m_bits |= load_u64_le(m_in.data() + m_pos) << m_count;
+                    m_pos += (63 - m_count) >> 3;
+                    m_count |= 56;
+                    return;
+                }
+
+                while (m_count <= 56)
+                {
+                    if (m_pos < m_in.size())
+                        m_bits |= std::uint64_t(static_cast<unsigned char>(m_in[m_pos])) << m_count;
+                    ++m_pos;
+                    m_count += 8;
+                }
+            }
+
+            std::uint64_t peek(unsigned bits) const
+            {
+                return m_bits & ((std::uint64_t(1) << bits) - 1);
+            }
+
+            void consume(unsigned bits)
+            {
+                m_bits >>= bits;
+                m_count -= bits;
+            }
+
+            //bits <= 56
+            std::uint64_t read(unsigned bits)
+            {
+                if (m_count < bits)
+                    refill();
+                const auto value = peek(bits);
+                consume(bits);
+                return value;
+            }
+
+            //Bits consumed so far
+            std::uint64_t position() const
+            {
+                return std::uint64_t(m_pos) * 8 - m_count;
+            }
+
+            std::uint64_t size() const
+            {
+                return std::uint64_t(m_in.size()) * 8;
+            }
+
+        private:
+            std::span<const char> m_in;
+            std::size_t m_pos = 0;
+            std::uint64_t m_bits = 0;
+            unsigned m_count = 0;
+        };
+
+        //BufferBitReader interface over a stream read in large blocks
+        class StreamBitReader
+        {
+        public:
+            explicit StreamBitReader(std::istream& in, std::size_t buffer_size = 1 << 16)
+                : m_in(in), m_buffer(buffer_size)
+            {}
+
+            void refill()
+            {
+                if (m_end - m_pos < sizeof(std::uint64_t))
+                    fill_buffer();
+
+                if (m_end - m_pos >= sizeof(std::uint64_t))
+                {
+                    m_bits |= load_u64_le(m_buffer.data() + m_pos) << m_count;
+                    m_pos += (63 - m_count) >> 3;
+                    m_count |= 56;
+                    return;
+                }
+
+                while (m_count <= 56)
+                {
+                    if (m_pos < m_end)
+                        m_bits |= std::uint64_t(static_cast<unsigned char>(m_buffer[m_pos++])) << m_count;
+                    m_count += 8;
+                }
+            }
+
+            std::uint64_t peek(unsigned bits) const
+            {
+                return m_bits & ((std::uint64_t(1) << bits) - 1);
+            }
+
+            void consume(unsigned bits)
+            {
+                m_bits >>= bits;
+                m_count -= bits;
+            }
+
+        private:
+            void fill_buffer()
+            {
+                const std::size_t left = m_end - m_pos;
+                std::memmove(m_buffer.data(), m_buffer.data() + m_pos, left);
+                m_pos = 0;
+                m_end = left;
+                while (m_in && m_end < m_buffer.size())
+                {
+                    m_in.read(m_buffer.data() + m_end, m_buffer.size() - m_end);
+                    m_end += m_in.gcount();
+                }
+            }
+
+            std::istream& m_in;
+            std::vector<char> m_buffer;
+            std::size_t m_pos = 0;
+            std::size_t m_end = 0;
+            std::uint64_t m_bits = 0;
+            unsigned m_count = 0;
+        };
+
+        //Writes bits in BitWriter order into a buffer through a 64 bit
+        //accumulator. Nothing reaches the buffer until flush
+        class BufferBitWriter
+        {
+        public:
+            explicit BufferBitWriter(std::span<char> out)
+                : m_out(out)
+            {}
+
+            //Pending bits plus length must not exceed 64, value must not
+            //have bits above length
+            void put(std::uint64_t value, unsigned length)
+            {
+                m_bits |= value << m_count;
+                m_count += length;
+            }
+
+            //length <= 57
+            void write(std::uint64_t value, unsigned length)
+            {
+                if (m_count + length > 64)
+                    flush();
+                put(value, length);
+            }
+
+            //Stores whole pending bytes, at most 7 bits stay pending
+            void flush()
+            {
+                const unsigned bytes = m_count >> 3;
+                if (m_pos + sizeof(std::uint64_t) <= m_out.size())
+                {
+                    store_u64_le(m_out.data() + m_pos, m_bits);
+                }
+                else
+                {
+                    if (m_pos + bytes > m_out.size())
+                        throw std::out_of_range("Bit writer buffer is full");
+                    for (unsigned i = 0; i < bytes; ++i)
+                        m_out[m_pos + i] = static_cast<char>(m_bits >> (i * 8));
+                }
+
+                m_pos += bytes;
+                m_bits = bytes == sizeof(m_bits) ? 0 : m_bits >> (bytes * 8);
+                m_count &= 7;
+            }
+
+            //Flushes everything padding the last byte with zeros, returns
+            //the number of bytes written
+            std::size_t finish()
+            {
+                flush();
+                if (m_count)
+                {
+                    if (m_pos >= m_out.size())
+                        throw std::out_of_range("Bit writer buffer is full");
+                    m_out[m_pos++] = static_cast<char>(m_bits);
+                    m_bits = 0;
+                    m_count = 0;
+                }
+                return m_pos;
+            }
+
+            //Whole bytes written to the buffer
+            std::span<const char> data() const { return m_out.first(m_pos); }
+            std::size_t size() const { return m_pos; }
+
+            //Lets the buffer be reused after its bytes were taken out,
+            //pending bits are kept
+            void rewind() { m_pos = 0; }
+
+            //Bits written since construction or the last rewind
+            std::uint64_t bits_written() const
+            {
+                return std::uint64_t(m_pos) * 8 + m_count;
+            }
+
+        private:
+            std::span<char> m_out;
+            std::size_t m_pos = 0;
+            std::uint64_t m_bits = 0;
+            unsigned m_count = 0;
+        };
+    }
+}
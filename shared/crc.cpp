@@ -0,0 +1,273 @@
+#include "crc.hpp"
+#include <stdexcept>
+
+namespace tik
+{
+    namespace crc
+    {
+        namespace
+        {
+            //Bytes a streaming variant reads at once for every thread
+            constexpr std::size_t STREAM_CHUNK = 1 << 22;
+
+            //Whole units of unit_size bytes
+            std::size_t stream_chunk(std::size_t unit_size, unsigned threads)
+            {
+                return std::max<std::size_t>(1, STREAM_CHUNK / unit_size) * unit_size * std::max(threads, 1u);
+            }
+
+            //Reads into buffer until it holds size bytes or input ends
+            void fill(std::istream& input, std::vector<char>& buffer, std::size_t size)
+            {
+                const auto have = buffer.size();
+                buffer.resize(size);
+                input.read(buffer.data() + have, size - have);
+                buffer.resize(have + input.gcount());
+            }
+        }
+
+        void validate(const Header& header)
+        {
+            if (header.model >= CATALOGUE.size())
+                throw std::invalid_argument("Unknown crc model");
+            if (header.block_size <= CATALOGUE[header.model]->width / 8
+                || header.block_size > MAX_BLOCK_SIZE)
+                throw std::invalid_argument("Unsupported block size");
+        }
+
+        void write_header(std::ostream& out, const Header& header)
+        {
+            validate(header);
+            out.write(MAGIC.data(), MAGIC.size());
+            out.put(static_cast<char>(header.model));
+            for (unsigned i = 0; i < 4; i++)
+                out.put(static_cast<char>(header.block_size >> (i * 8)));
+        }
+
+        std::size_t read_header(std::span<const char> data, Header& header)
+        {
+            if (data.size() < HEADER_SIZE || !std::equal(MAGIC.begin(), MAGIC.end(), data.begin()))
+            {
+                header = Header();
+                return 0;
+            }
+
+            header.model = static_cast<unsigned char>(data[MAGIC.size()]);
+            header.block_size = 0;
+            for (unsigned i = 0; i < 4; i++)
+                header.block_size |= std::size_t(static_cast<unsigned char>(data[MAGIC.size() + 1 + i])) << (i * 8);
+            validate(header);
+            return HEADER_SIZE;
+        }
+
+        std::optional<std::size_t> find_model(std::string_view name)
+        {
+            for (std::size_t i = 0; i < CATALOGUE.size(); i++)
+            {
+                if (CATALOGUE[i]->name == name)
+                    return i;
+            }
+            return std::nullopt;
+        }
+
+        std::uint64_t encode(const std::filesystem::path& from, const std::filesystem::path& to,
+                             const Options& options)
+        {
+            const Header header{options.model, options.block_size};
+            validate(header);
+
+            const utils::MappedFile input(from);
+            std::ofstream output(to, std::ios::binary);
+            write_header(output, header);
+            return visit_model(options.model, [&]<const Model& model>() -> std::uint64_t
+            {
+                return encode<model>(input.data(), output, options.block_size, options.threads);
+            });
+        }
+
+        std::uint64_t check(const std::filesystem::path& from, std::ostream& log, unsigned threads)
+        {
+            const utils::MappedFile input(from);
+            Header header;
+            const auto blocks = input.data().subspan(read_header(input.data(), header));
+            return visit_model(header.model, [&]<const Model& model>() -> std::uint64_t
+            {
+                return check<model>(blocks, log, header.block_size, threads);
+            });
+        }
+
+        DecodeResult decode(const std::filesystem::path& from, const std::filesystem::path& to,
+                            std::ostream& log, const DecodeOptions& options)
+        {
+            const utils::MappedFile input(from);
+            Header header;
+            const auto blocks = input.data().subspan(read_header(input.data(), header));
+            std::ofstream output(to, std::ios::binary);
+            try
+            {
+                return visit_model<DecodeResult>(header.model, [&]<const Model& model>()
+                {
+                    return decode<model>(blocks, output, log, header.block_size, options);
+                });
+            }
+            catch (const std::runtime_error&)
+            {
+                //Payloads before the bad block are not a usable restore
+                output.close();
+                std::filesystem::remove(to);
+                throw;
+            }
+        }
+
+        std::uint64_t encode(std::istream& input, std::ostream& output, const Options& options)
+        {
+            const Header header{options.model, options.block_size};
+            write_header(output, header);
+            return visit_model(options.model, [&]<const Model& model>() -> std::uint64_t
+            {
+                //Chunks hold whole payloads, so blocks do not depend on them
+                const auto chunk = stream_chunk(options.block_size - model.width / 8, options.threads);
+                auto file_crc = encode_span_sliced<model>({});
+                std::vector<char> buffer;
+                while (true)
+                {
+                    buffer.clear();
+                    fill(input, buffer, chunk);
+                    if (buffer.empty())
+                        break;
+
+                    const auto crc = encode<model>(buffer, output, options.block_size, options.threads);
+                    file_crc = combine<model>(file_crc, crc, buffer.size());
+                    if (buffer.size() < chunk)
+                        break;
+                }
+                return file_crc;
+            });
+        }
+
+        DecodeResult decode(std::istream& input, std::ostream& output,
+                            std::ostream& log, const DecodeOptions& options)
+        {
+            //Bytes of a headerless file belong to its first block
+            std::vector<char> buffer;
+            fill(input, buffer, HEADER_SIZE);
+            Header header;
+            buffer.erase(buffer.begin(), buffer.begin() + read_header(buffer, header));
+
+            return visit_model<DecodeResult>(header.model, [&]<const Model& model>()
+            {
+                using T = Register<model.width>;
+                const auto chunk = stream_chunk(header.block_size, options.threads);
+                T file_crc = encode_span_sliced<model>({});
+                DecodeResult total{0, 0, 0};
+                std::size_t first_block = 0;
+                while (true)
+                {
+                    fill(input, buffer, chunk);
+                    if (buffer.empty())
+                        break;
+
+                    const auto result = decode<model>(buffer, output, log, header.block_size,
+                                                      options, first_block);
+                    const auto blocks = buffer.size() / header.block_size;
+                    const auto rest = buffer.size() % header.block_size;
+                    file_crc = combine<model>(file_crc, static_cast<T>(result.crc),
+                                              decoded_size(buffer.size(), header));
+                    total.failed += result.failed;
+                    total.repaired += result.repaired;
+                    first_block += blocks + (rest != 0);
+                    if (buffer.size() < chunk)
+                        break;
+                    buffer.clear();
+                }
+                total.crc = file_crc;
+                return total;
+            });
+        }
+
+        std::uint64_t encoded_size(std::uint64_t size, const Header& header)
+        {
+            const auto bytes = CATALOGUE[header.model]->width / 8;
+            const auto payload_size = header.block_size - bytes;
+            return size / payload_size * header.block_size
+                + (size % payload_size ? size % payload_size + bytes : 0);
+        }
+
+        std::uint64_t decoded_size(std::uint64_t size, const Header& header)
+        {
+            const auto bytes = CATALOGUE[header.model]->width / 8;
+            const auto rest = size % header.block_size;
+            return size / header.block_size * (header.block_size - bytes) + rest - std::min<std::uint64_t>(rest, bytes);
+        }
+
+        std::uint64_t encode(std::span<const std::byte> input, std::span<std::byte> output,
+                             const Options& options)
+        {
+            const Header header{options.model, options.block_size};
+            validate(header);
+            const auto in = utils::as_chars(input);
+            const auto out = utils::as_writable_chars(output);
+            if (out.size() < HEADER_SIZE + encoded_size(in.size(), header))
+                throw std::invalid_argument("Output buffer is too small");
+
+            std::copy(MAGIC.begin(), MAGIC.end(), out.begin());
+            out[MAGIC.size()] = static_cast<char>(header.model);
+            for (unsigned i = 0; i < 4; i++)
+                out[MAGIC.size() + 1 + i] = static_cast<char>(header.block_size >> (i * 8));
+
+            return visit_model(header.model, [&]<const Model& model>() -> std::uint64_t
+            {
+                const auto block_shift = zeros_operator<model>(header.block_size - model.width / 8);
+                return encode_blocks<model>(in, out.data() + HEADER_SIZE, header.block_size, block_shift);
+            });
+        }
+
+        std::size_t decoded_size(std::span<const std::byte> input)
+        {
+            const auto in = utils::as_chars(input);
+            Header header;
+            const auto header_size = read_header(in, header);
+            return decoded_size(in.size() - header_size, header);
+        }
+
+        DecodeResult decode(std::span<const std::byte> input, std::span<std::byte> output)
+        {
+            const auto in = utils::as_chars(input);
+            Header header;
+            const auto blocks = in.subspan(read_header(in, header));
+            if (output.size() < decoded_size(blocks.size(), header))
+                throw std::invalid_argument("Output buffer is too small");
+
+            return visit_model<DecodeResult>(header.model, [&]<const Model& model>()
+            {
+                return decode<model>(blocks, utils::as_writable_chars(output), header.block_size);
+            });
+        }
+
+        std::size_t update(const std::filesystem::path& from, const std::filesystem::path& encoded,
+                           std::span<const Range> ranges)
+        {
+            const utils::MappedFile input(from);
+            Header header;
+            std::size_t rewritten;
+            std::uint64_t header_size;
+            {
+                const utils::MappedFile old(encoded);
+                header_size = read_header(old.data(), header);
+                std::fstream output(encoded, std::ios::in | std::ios::out | std::ios::binary);
+                rewritten = visit_model<std::size_t>(header.model, [&]<const Model& model>()
+                {
+                    return update<model>(input.data(), old.data().subspan(header_size), output,
+                                         header_size, header.block_size, ranges);
+                });
+                if (!output)
+                    throw std::runtime_error("Failed to write " + encoded.string());
+            }
+
+            const auto size = header_size + encoded_size(input.size(), header);
+            if (std::filesystem::file_size(encoded) > size)
+                std::filesystem::resize_file(encoded, size);
+            return rewritten;
+        }
+    }
+}
@@ -1,12 +1,27 @@
+#pragma once
 #include "utils.hpp"
+#include "crc_clmul.hpp"
+#include "crc_sse42.hpp"
 #include <cstdint>
 #include <array>
+#include <bit>
 #include <bitset>
+#include <type_traits>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <algorithm>
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
 
 namespace tik
 {
@@ -79,128 +94,979 @@ namespace tik
             return result;
         }
 
-        template <const auto& poly>
-        void encode(const std::filesystem::path& from,
-                    const std::filesystem::path& to)
+        //Smallest native unsigned type holding an N bit crc
+        template <std::size_t N>
+        using Register = std::conditional_t<N <= 16, std::uint16_t,
+                         std::conditional_t<N <= 32, std::uint32_t, std::uint64_t>>;
+
+        //Crc parameters in the usual catalogue form. poly is given without
+        //the top term and init for an msb first register, refin processes
+        //bytes lowest bit first and refout reflects the result before
+        //xorout is applied
+        struct Model
         {
-            constexpr auto N = poly.size();
+            std::string_view name;
+            std::size_t width;
+            std::uint64_t poly;
+            std::uint64_t init;
+            bool refin;
+            bool refout;
+            std::uint64_t xorout;
+        };
+
+        constexpr std::uint64_t reflect(std::uint64_t value, std::size_t width)
+        {
+            std::uint64_t result = 0;
+            for (std::size_t i = 0; i < width; i++, value >>= 1)
+                result = (result << 1) | (value & 1);
+            return result;
+        }
+
+        //Models of the bitset polynomials above, build_table reduces them
+        //modulo x^N + table[1]
+        template <std::size_t N>
+        constexpr Model bitset_model(std::string_view name, const std::bitset<N>& poly)
+        {
+            constexpr std::uintmax_t mask = N == 64 ? ~std::uintmax_t(0) : (std::uintmax_t(1) << N) - 1;
+            return Model{name, N, utils::to_uintmax(build_table(poly)[1]) & mask, 0, false, false, 0};
+        }
+
+        inline constexpr Model TIK_16 = bitset_model("tik-16", CRC_16_ANSI);
+        inline constexpr Model TIK_32 = bitset_model("tik-32", CRC_32);
+        inline constexpr Model TIK_32C = bitset_model("tik-32c", CRC_32C);
+        inline constexpr Model CRC_16_ARC{"crc-16/arc", 16, 0x8005, 0, true, true, 0};
+        inline constexpr Model CRC_16_IBM_3740{"crc-16/ibm-3740", 16, 0x1021, 0xFFFF, false, false, 0};
+        inline constexpr Model CRC_32_ISO_HDLC{"crc-32/iso-hdlc", 32, 0x04C11DB7, 0xFFFFFFFF,
+                                               true, true, 0xFFFFFFFF};
+        inline constexpr Model CRC_32_ISCSI{"crc-32/iscsi", 32, 0x1EDC6F41, 0xFFFFFFFF,
+                                            true, true, 0xFFFFFFFF};
+        inline constexpr Model CRC_64_XZ{"crc-64/xz", 64, 0x42F0E1EBA9EA3693, ~std::uint64_t(0),
+                                         true, true, ~std::uint64_t(0)};
+
+        //Models selectable at run time, file headers store the index
+        inline constexpr std::array<const Model*, 8> CATALOGUE = {
+            &TIK_16, &TIK_32, &TIK_32C, &CRC_16_ARC, &CRC_16_IBM_3740,
+            &CRC_32_ISO_HDLC, &CRC_32_ISCSI, &CRC_64_XZ};
+
+        //Calls f.template operator()<model>() for the catalogue model at
+        //index, the instantiations for every model are built up front
+        template <typename R = std::uint64_t, std::size_t I = 0, typename F>
+        R visit_model(std::size_t index, F&& f)
+        {
+            if constexpr (I == CATALOGUE.size())
+                throw std::invalid_argument("Unknown crc model");
+            else if (index == I)
+                return f.template operator()<*CATALOGUE[I]>();
+            else
+                return visit_model<R, I + 1>(index, std::forward<F>(f));
+        }
+
+        //tables[k][b] is the crc of byte b followed by k zero bytes, so
+        //Slices bytes are folded with independent lookups. Reflected models
+        //keep the register reflected and shift it right
+        template <const Model& model, std::size_t Slices>
+        constexpr auto build_slicing_tables()
+        {
+            constexpr auto N = model.width;
+            static_assert(N % 8 == 0 && N >= 8 && N <= 64, "Crc width must be whole bytes");
+            using T = Register<N>;
+            constexpr std::uintmax_t mask = N == 64 ? ~std::uintmax_t(0) : (std::uintmax_t(1) << N) - 1;
+
+            std::array<std::array<T, 256>, Slices> result{};
+            for (unsigned i = 0; i < 256; i++)
+            {
+                if constexpr (model.refin)
+                {
+                    const std::uintmax_t poly = reflect(model.poly, N);
+                    std::uintmax_t reg = i;
+                    for (int j = 0; j < 8; j++)
+                        reg = (reg >> 1) ^ (reg & 1 ? poly : 0);
+                    result[0][i] = static_cast<T>(reg);
+                }
+                else
+                {
+                    const std::uintmax_t top = std::uintmax_t(1) << (N - 1);
+                    std::uintmax_t reg = std::uintmax_t(i) << (N - 8);
+                    for (int j = 0; j < 8; j++)
+                        reg = ((reg << 1) & mask) ^ (reg & top ? model.poly : 0);
+                    result[0][i] = static_cast<T>(reg);
+                }
+            }
+
+            for (std::size_t k = 1; k < Slices; k++)
+            {
+                for (unsigned i = 0; i < 256; i++)
+                {
+                    const T prev = result[k - 1][i];
+                    if constexpr (model.refin)
+                        result[k][i] = static_cast<T>((std::uintmax_t(prev) >> 8) ^ result[0][prev & 0xFF]);
+                    else
+                        result[k][i] = static_cast<T>(((std::uintmax_t(prev) << 8) & mask)
+                            ^ result[0][prev >> (N - 8)]);
+                }
+            }
+            return result;
+        }
+
+        template <const Model& model, std::size_t Slices>
+        inline constexpr auto slicing_tables = build_slicing_tables<model, Slices>();
+
+        //Register before the first byte and the crc a register stands for
+        template <const Model& model>
+        constexpr Register<model.width> initial_register()
+        {
+            return static_cast<Register<model.width>>(model.refin ? reflect(model.init, model.width) : model.init);
+        }
+
+        template <const Model& model>
+        constexpr Register<model.width> finalize(Register<model.width> reg)
+        {
+            if constexpr (model.refin != model.refout)
+                reg = static_cast<Register<model.width>>(reflect(reg, model.width));
+            return static_cast<Register<model.width>>(reg ^ model.xorout);
+        }
+
+        template <const Model& model>
+        constexpr Register<model.width> unfinalize(Register<model.width> crc)
+        {
+            crc = static_cast<Register<model.width>>(crc ^ model.xorout);
+            if constexpr (model.refin != model.refout)
+                crc = static_cast<Register<model.width>>(reflect(crc, model.width));
+            return crc;
+        }
+
+        //Runs the register over one zero byte
+        template <const Model& model>
+        constexpr Register<model.width> shift_zero_byte(Register<model.width> reg)
+        {
+            constexpr auto N = model.width;
+            constexpr std::uintmax_t mask = N == 64 ? ~std::uintmax_t(0) : (std::uintmax_t(1) << N) - 1;
+            constexpr auto& table = slicing_tables<model, 1>[0];
+            if constexpr (model.refin)
+                return static_cast<Register<N>>((std::uintmax_t(reg) >> 8) ^ table[reg & 0xFF]);
+            else
+                return static_cast<Register<N>>(((std::uintmax_t(reg) << 8) & mask) ^ table[reg >> (N - 8)]);
+        }
+
+        //Runs the register over span, Slices bytes per step
+        template <const Model& model, std::size_t Slices = 16>
+        constexpr Register<model.width> update_sliced(Register<model.width> crc,
+                                                      std::span<const char> span)
+        {
+            constexpr auto N = model.width;
             constexpr auto Bytes = N/8;
-            std::ifstream input(from, std::ios::binary);
-            std::ofstream output(to, std::ios::binary);
+            static_assert(Bytes <= Slices, "Slices must cover the crc");
+            using T = Register<N>;
+            constexpr std::uintmax_t mask = N == 64 ? ~std::uintmax_t(0) : (std::uintmax_t(1) << N) - 1;
+            constexpr auto& tables = slicing_tables<model, Slices>;
 
-            std::array<char, BLOCK_SIZE - Bytes> block;
+            std::size_t i = 0;
+            for (; i + Slices <= span.size(); i += Slices)
+            {
+                //The crc is shifted out entirely, its bytes meet the first
+                //data bytes
+                T next = 0;
+                for (std::size_t j = 0; j < Slices; j++)
+                {
+                    auto byte = static_cast<unsigned char>(span[i + j]);
+                    if (j < Bytes)
+                    {
+                        if constexpr (model.refin)
+                            byte ^= static_cast<unsigned char>(crc >> (8 * j));
+                        else
+                            byte ^= static_cast<unsigned char>(crc >> (N - 8 * (j + 1)));
+                    }
+                    next ^= tables[Slices - 1 - j][byte];
+                }
+                crc = next;
+            }
 
-            auto encode_and_write = [&](auto span)
+            for (; i < span.size(); i++)
             {
-                auto crc = encode_span<poly>(span).to_ulong();
-                crc <<= (sizeof(crc) - Bytes)*8;
-                crc = utils::swap_endian(crc);
-                output.write(span.data(), span.size());
-                output.write(reinterpret_cast<const char*>(&crc), Bytes);
-            };
+                const auto byte = static_cast<unsigned char>(span[i]);
+                if constexpr (model.refin)
+                    crc = static_cast<T>((std::uintmax_t(crc) >> 8) ^ tables[0][(crc ^ byte) & 0xFF]);
+                else
+                    crc = static_cast<T>(((std::uintmax_t(crc) << 8) & mask)
+                        ^ tables[0][static_cast<unsigned char>(crc >> (N - 8)) ^ byte]);
+            }
+            return crc;
+        }
+
+        template <const Model& model, std::size_t Slices = 16>
+        constexpr Register<model.width> encode_span_sliced(std::span<const char> span)
+        {
+            return finalize<model>(update_sliced<model, Slices>(initial_register<model>(), span));
+        }
 
-            while(input.read(block.data(), block.size()))
+        //Uses the crc32 instruction for the Castagnoli crc, carry-less
+        //multiplication folding for msb first models when the CPU has them
+        //and the slicing engine for the rest
+        template <const Model& model>
+        Register<model.width> update(Register<model.width> crc, std::span<const char> span)
+        {
+#if TIK_CRC_SSE42
+            if constexpr (model.width == 32 && model.refin && model.poly == sse42::POLY)
             {
-                encode_and_write(std::span(block));
+                if (sse42::supported())
+                    return sse42::update(crc, span);
             }
-            //Last block
-            if (input.gcount())
+#endif
+#if TIK_CRC_CLMUL
+            if constexpr (!model.refin)
             {
-                encode_and_write(std::span(block.data(), input.gcount()));
+                if (span.size() >= clmul::MIN_SIZE && clmul::supported())
+                {
+                    std::array<char, 16> remainder;
+                    const auto folded = clmul::fold_span<model.poly, model.width>(crc, span, remainder);
+                    crc = update_sliced<model>(0, remainder);
+                    span = span.subspan(folded);
+                }
             }
+#endif
+            return update_sliced<model>(crc, span);
+        }
+
+        template <const Model& model>
+        Register<model.width> encode_span_fast(std::span<const char> span)
+        {
+            return finalize<model>(update<model>(initial_register<model>(), span));
         }
 
-        template <const auto& poly>
-        constexpr auto build_crc_bit_error_array()
+        //GF(2) matrix over crc registers, column i is the image of bit i
+        template <std::size_t N>
+        using Matrix = std::array<Register<N>, N>;
+
+        template <std::size_t N>
+        constexpr Register<N> multiply(const Matrix<N>& matrix, Register<N> vector)
         {
-            constexpr auto Bytes = poly.size()/8;
-            std::array<std::pair<unsigned long, std::size_t>, BLOCK_SIZE * 8> result;
-            std::array<char, BLOCK_SIZE> buffer{};
-            for (std::size_t i = 0; i < BLOCK_SIZE * 8; i++)
+            Register<N> result = 0;
+            for (std::size_t i = 0; vector; i++, vector >>= 1)
             {
-                utils::flip_bit(buffer.begin(), i);
-                result[i] = std::pair(
-                    encode_span_constexpr<poly>(std::span(buffer)), i);
-                utils::flip_bit(buffer.begin(), i);
+                if (vector & 1)
+                    result ^= matrix[i];
             }
-            std::ranges::sort(result, std::ranges::less{},
-                              [](const auto& p) { return p.first; });
-            std::cout << "Done building table\n";
             return result;
         }
 
-        template <const auto& poly>
-        void check(const std::filesystem::path& from, std::ostream& log_stream)
+        template <std::size_t N>
+        constexpr Matrix<N> multiply(const Matrix<N>& a, const Matrix<N>& b)
         {
-            constexpr auto N = poly.size();
+            Matrix<N> result{};
+            for (std::size_t i = 0; i < N; i++)
+                result[i] = multiply<N>(a, b[i]);
+            return result;
+        }
+
+        //Operator that runs a crc register over length zero bytes, built by
+        //squaring the one byte operator
+        template <const Model& model>
+        constexpr Matrix<model.width> zeros_operator(std::uintmax_t length)
+        {
+            constexpr auto N = model.width;
+            using T = Register<N>;
+
+            Matrix<N> power{};
+            Matrix<N> result{};
+            for (std::size_t i = 0; i < N; i++)
+            {
+                const T bit = static_cast<T>(T(1) << i);
+                power[i] = shift_zero_byte<model>(bit);
+                result[i] = bit;
+            }
+
+            for (; length; length >>= 1)
+            {
+                if (length & 1)
+                    result = multiply<N>(power, result);
+                power = multiply<N>(power, power);
+            }
+            return result;
+        }
+
+        //crc(A + B) from crc(A), crc(B) and the zeros operator for the
+        //length of B. Registers are linear once init is taken out
+        template <const Model& model>
+        constexpr Register<model.width> combine(Register<model.width> crc_a,
+                                                Register<model.width> crc_b,
+                                                const Matrix<model.width>& zeros_b)
+        {
+            constexpr auto init = initial_register<model>();
+            const auto shifted = multiply<model.width>(zeros_b, unfinalize<model>(crc_a) ^ init);
+            return finalize<model>(shifted ^ unfinalize<model>(crc_b));
+        }
+
+        template <const Model& model>
+        constexpr Register<model.width> combine(Register<model.width> crc_a,
+                                                Register<model.width> crc_b,
+                                                std::uintmax_t length_b)
+        {
+            return combine<model>(crc_a, crc_b, zeros_operator<model>(length_b));
+        }
+
+        //Encoded files start with the magic, the catalogue index of the
+        //model and the block size as u32 LE. Files without the magic are
+        //TIK_16 blocks of BLOCK_SIZE bytes
+        constexpr std::array<char, 4> MAGIC = {'T', 'I', 'K', 'C'};
+        constexpr std::size_t HEADER_SIZE = MAGIC.size() + 1 + 4;
+        constexpr std::size_t MAX_BLOCK_SIZE = std::size_t(1) << 24;
+
+        struct Header
+        {
+            std::size_t model = 0;
+            std::size_t block_size = BLOCK_SIZE;
+        };
+
+        //Blocks have to hold a crc and at least one payload byte
+        void validate(const Header& header);
+        void write_header(std::ostream& out, const Header& header);
+        //Returns the number of header bytes at the start of data
+        std::size_t read_header(std::span<const char> data, Header& header);
+
+        std::optional<std::size_t> find_model(std::string_view name);
+
+        //Blocks handled by one task of parallel encode and check
+        constexpr std::size_t TASK_BLOCKS = 256;
+
+        //Copies the payloads of input to out, each followed by its crc as
+        //big endian bytes. Returns the crc of the whole input
+        template <const Model& model>
+        Register<model.width> encode_blocks(std::span<const char> input, char* out, std::size_t block_size,
+                                            const Matrix<model.width>& block_shift)
+        {
+            constexpr auto Bytes = model.width / 8;
+            using T = Register<model.width>;
+            const auto payload_size = block_size - Bytes;
+
+            T result = encode_span_sliced<model>({});
+            for (std::size_t offset = 0; offset < input.size(); offset += payload_size)
+            {
+                const auto block = input.subspan(offset, std::min(payload_size, input.size() - offset));
+                const T crc = encode_span_fast<model>(block);
+                result = block.size() == payload_size
+                    ? combine<model>(result, crc, block_shift)
+                    : combine<model>(result, crc, block.size());
+
+                std::copy(block.begin(), block.end(), out);
+                out += block.size();
+                for (std::size_t i = Bytes; i != 0; i--)
+                    *out++ = static_cast<char>(crc >> ((i - 1) * 8));
+            }
+            return result;
+        }
+
+        //Appends the crc of every block and returns the crc of the whole
+        //input. Blocks are coded on threads and written in order
+        template <const Model& model>
+        Register<model.width> encode(std::span<const char> input, std::ostream& output,
+                                     std::size_t block_size = BLOCK_SIZE, unsigned threads = 1)
+        {
+            constexpr auto N = model.width;
+            constexpr auto Bytes = N/8;
+            const auto payload_size = block_size - Bytes;
+            using T = Register<N>;
+
+            const auto block_shift = zeros_operator<model>(payload_size);
+            const T empty = encode_span_sliced<model>({});
+
+            struct Encoded
+            {
+                std::string data;
+                T crc;
+                std::size_t size;
+            };
+
+            auto encode_task = [&](std::span<const char> chunk)
+            {
+                const auto blocks = (chunk.size() + payload_size - 1) / payload_size;
+                Encoded result{std::string(chunk.size() + blocks * Bytes, '\0'), empty, chunk.size()};
+                result.crc = encode_blocks<model>(chunk, result.data.data(), block_size, block_shift);
+                return result;
+            };
+
+            T file_crc = empty;
+            auto rest = input;
+            utils::ThreadPool pool(threads);
+            utils::ordered_for_each(
+                pool,
+                [&]() -> std::optional<std::span<const char>>
+                {
+                    if (rest.empty())
+                        return std::nullopt;
+                    const auto chunk = rest.first(std::min(TASK_BLOCKS * payload_size, rest.size()));
+                    rest = rest.subspan(chunk.size());
+                    return chunk;
+                },
+                encode_task,
+                [&](Encoded encoded)
+                {
+                    output.write(encoded.data.data(), encoded.data.size());
+                    file_crc = combine<model>(file_crc, encoded.crc, encoded.size);
+                });
+            return file_crc;
+        }
+
+        //Finds bit errors from the syndrome of a damaged block, the stored
+        //crc xor the crc of the payload. A flipped bit d bits from the
+        //block end (lowest bit of the last byte is 0) is either a bit of
+        //the stored crc or leaves the crc of a one hot byte shifted over
+        //zero bytes, so every syndrome follows from the byte table without
+        //running the crc over whole blocks. Syndromes are kept in an open
+        //addressing hash table, lookups do not allocate. Blocks longer than
+        //the period of the polynomial give several bits the same syndrome,
+        //such syndromes are not located
+        template <const Model& model>
+        class ErrorLocator
+        {
+        public:
+            using T = Register<model.width>;
+
+            //Larger blocks are not located, the tables would take hundreds
+            //of megabytes
+            static constexpr std::size_t MAX_BLOCK_SIZE = std::size_t(1) << 16;
+
+            struct Pair
+            {
+                std::size_t first;
+                std::size_t second;
+            };
+
+            //Throws std::invalid_argument above MAX_BLOCK_SIZE
+            explicit ErrorLocator(std::size_t block_size)
+                : m_syndromes(checked_bits(block_size)),
+                  m_slots(std::bit_ceil(block_size * 16)),
+                  m_shift(64 - std::countr_zero(m_slots.size()))
+            {
+                constexpr auto Bytes = model.width / 8;
+                constexpr auto& table = slicing_tables<model, 1>[0];
+
+                //Crc bytes are stored msb first
+                std::array<T, 8> payload{};
+                for (std::size_t d = 0; d < m_syndromes.size(); d++)
+                {
+                    if (d < 8 * Bytes)
+                    {
+                        m_syndromes[d] = static_cast<T>(T(1) << d);
+                        continue;
+                    }
+
+                    auto& bit = payload[d % 8];
+                    bit = d < 8 * Bytes + 8 ? table[1u << (d % 8)] : shift_zero_byte<model>(bit);
+                    if constexpr (model.refin != model.refout)
+                        m_syndromes[d] = static_cast<T>(reflect(bit, model.width));
+                    else
+                        m_syndromes[d] = bit;
+                }
+
+                for (std::size_t d = 0; d < m_syndromes.size(); d++)
+                {
+                    if (!m_syndromes[d])
+                        continue;
+
+                    std::size_t slot = hash(m_syndromes[d]);
+                    while (m_slots[slot].distance && m_slots[slot].syndrome != m_syndromes[d])
+                        slot = (slot + 1) & (m_slots.size() - 1);
+                    if (!m_slots[slot].distance)
+                        m_slots[slot] = Slot{m_syndromes[d], static_cast<std::uint32_t>(d + 1), false};
+                    else
+                        m_slots[slot].ambiguous = true;
+                }
+            }
+
+            //Bit pairs of a block outnumber the syndromes of narrow crcs,
+            //almost any syndrome would then match some pair
+            bool pairs() const
+            {
+                return model.width >= 2 * std::bit_width(m_syndromes.size());
+            }
+
+            T syndrome(std::size_t distance) const
+            {
+                return m_syndromes[distance];
+            }
+
+            //Distance from the block end of the only bit whose flip gives
+            //syndrome
+            std::optional<std::size_t> locate(T syndrome) const
+            {
+                for (std::size_t slot = hash(syndrome); m_slots[slot].distance;
+                     slot = (slot + 1) & (m_slots.size() - 1))
+                {
+                    if (m_slots[slot].syndrome == syndrome)
+                    {
+                        if (m_slots[slot].ambiguous)
+                            return std::nullopt;
+                        return m_slots[slot].distance - 1;
+                    }
+                }
+                return std::nullopt;
+            }
+
+            //Two distinct bits within size bytes of the block end whose
+            //flips add up to syndrome, first < second
+            std::optional<Pair> locate_pair(T syndrome, std::size_t size) const
+            {
+                const auto bits = std::min(size * 8, m_syndromes.size());
+                for (std::size_t d = 0; d < bits; d++)
+                {
+                    const auto other = locate(syndrome ^ m_syndromes[d]);
+                    if (other && *other > d && *other < bits)
+                        return Pair{d, *other};
+                }
+                return std::nullopt;
+            }
+
+        private:
+            struct Slot
+            {
+                T syndrome;
+                //Distance + 1, 0 - empty slot
+                std::uint32_t distance;
+                //Another bit has the same syndrome
+                bool ambiguous;
+            };
+
+            static std::size_t checked_bits(std::size_t block_size)
+            {
+                if (block_size > MAX_BLOCK_SIZE)
+                    throw std::invalid_argument("Block is too large to locate errors");
+                return block_size * 8;
+            }
+
+            std::size_t hash(T syndrome) const
+            {
+                return static_cast<std::size_t>((std::uint64_t(syndrome) * 0x9E3779B97F4A7C15ull) >> m_shift);
+            }
+
+            std::vector<T> m_syndromes;
+            //Load factor at most 1/2
+            std::vector<Slot> m_slots;
+            unsigned m_shift;
+        };
+
+        //Builds the locator of a block size when the first damaged block
+        //asks for it, intact files never pay for the tables. Tasks on
+        //threads share the one locator
+        template <const Model& model>
+        class LazyLocator
+        {
+        public:
+            explicit LazyLocator(std::size_t block_size)
+                : m_block_size(block_size)
+            {}
+
+            //Nothing for blocks above ErrorLocator::MAX_BLOCK_SIZE
+            const ErrorLocator<model>* get()
+            {
+                if (m_block_size > ErrorLocator<model>::MAX_BLOCK_SIZE)
+                    return nullptr;
+                std::call_once(m_built, [this]() { m_locator.emplace(m_block_size); });
+                return &*m_locator;
+            }
+
+        private:
+            std::size_t m_block_size;
+            std::once_flag m_built;
+            std::optional<ErrorLocator<model>> m_locator;
+        };
+
+        //Block bit index of a bit distance bits from the end of a block of
+        //size bytes, the numbering used by utils::flip_bit
+        constexpr std::size_t block_bit(std::size_t size, std::size_t distance)
+        {
+            return (size - 1 - distance / 8) * 8 + distance % 8;
+        }
+
+        //Logs the state of every block and returns the crc of the whole
+        //payload. Blocks are checked on threads, the log keeps block order
+        template <const Model& model>
+        Register<model.width> check(std::span<const char> data, std::ostream& log_stream,
+                                    std::size_t block_size = BLOCK_SIZE, unsigned threads = 1)
+        {
+            constexpr auto N = model.width;
             constexpr auto Bytes = N/8;
-            const auto bit_table = build_crc_bit_error_array<poly>();
-            std::ifstream input(from, std::ios::binary);
-            std::array<char, BLOCK_SIZE> block;
+            using T = Register<N>;
+            LazyLocator<model> locator(block_size);
+            const auto block_shift = zeros_operator<model>(block_size - Bytes);
+            const T empty = encode_span_sliced<model>({});
 
+            //The log shows stored bytes read lowest first
             auto get_crc_from_memory = [](auto span)
             {
-                unsigned long result = 0;
+                std::uint64_t result = 0;
                 for (std::size_t i = span.size(); i != 0; i--)
                 {
-                    result |= (static_cast<unsigned char>(span[i - 1]) << ((i - 1) * 8));
+                    result |= std::uint64_t(static_cast<unsigned char>(span[i - 1])) << ((i - 1) * 8);
                 }
                 return result;
             };
 
-            auto check_and_log = [&](auto span, std::size_t i)
+            auto get_stored_crc = [](auto span)
             {
-                auto initial_crc =
-                    get_crc_from_memory(span.last(Bytes));
-                auto crc = encode_span<poly>(span).to_ulong();
+                T result = 0;
+                for (const char c : span)
+                    result = static_cast<T>((std::uintmax_t(result) << 8) | static_cast<unsigned char>(c));
+                return result;
+            };
 
-                log_stream << "Checking block " << i << ", crc: "
-                           << initial_crc << std::endl;
-                if (crc != 0)
+            struct Checked
+            {
+                std::string log;
+                T crc;
+                std::size_t size;
+            };
+
+            auto check_and_log = [&](std::span<const char> span, std::size_t i, std::ostream& log)
+            {
+                const auto stored = span.last(std::min(Bytes, span.size()));
+                const T payload_crc = encode_span_fast<model>(span.first(span.size() - stored.size()));
+                const T syndrome = payload_crc ^ get_stored_crc(stored);
+
+                log << "Checking block " << i << ", crc: "
+                    << get_crc_from_memory(stored) << "\n";
+                if (syndrome != 0)
                 {
-                    auto range = std::ranges::equal_range(bit_table, crc, std::ranges::less {},
-                                                          [](const auto& pair) { return pair.first; });
-                    if (range.begin() != range.end())
+                    const auto* found = locator.get();
+                    const auto distance = found ? found->locate(syndrome) : std::nullopt;
+                    const auto pair = distance || !found || !found->pairs() ? std::nullopt
+                        : found->locate_pair(syndrome, span.size());
+                    if (distance && *distance < span.size() * 8)
+                    {
+                        log << "possible 1 bit error at block bit "
+                            << block_bit(span.size(), *distance) << "\n";
+                    }
+                    else if (pair)
                     {
-                        log_stream << "possible 1 bit error at block bit "
-                                   << range.begin()->second << std::endl;
+                        log << "possible 2 bit error at block bits "
+                            << block_bit(span.size(), pair->second) << " and "
+                            << block_bit(span.size(), pair->first) << "\n";
                     }
-                    log_stream << "failed: " << crc << "\n\n";
+                    log << "failed: " << syndrome << "\n\n";
                 }
                 else
                 {
-                    log_stream << "successful: " << crc << "\n\n";
+                    log << "successful: " << syndrome << "\n\n";
                 }
+                return payload_crc;
             };
 
-            std::size_t i = 0;
-            while(input.read(block.data(), block.size()))
+            std::size_t next = 0;
+            T file_crc = empty;
+            utils::ThreadPool pool(threads);
+            utils::ordered_for_each(
+                pool,
+                [&]() -> std::optional<std::size_t>
+                {
+                    if (next * block_size >= data.size())
+                        return std::nullopt;
+                    return std::exchange(next, next + TASK_BLOCKS);
+                },
+                [&](std::size_t first)
+                {
+                    Checked result{std::string(), empty, 0};
+                    std::ostringstream log;
+                    const auto end = std::min(data.size(), (first + TASK_BLOCKS) * block_size);
+                    for (std::size_t i = first; i * block_size < end; i++)
+                    {
+                        const auto block = data.subspan(i * block_size, std::min(block_size, end - i * block_size));
+                        const auto payload_size = block.size() - std::min(Bytes, block.size());
+                        const T crc = check_and_log(block, i, log);
+                        result.crc = block.size() == block_size
+                            ? combine<model>(result.crc, crc, block_shift)
+                            : combine<model>(result.crc, crc, payload_size);
+                        result.size += payload_size;
+                    }
+                    result.log = std::move(log).str();
+                    return result;
+                },
+                [&](Checked checked)
+                {
+                    log_stream << checked.log << std::flush;
+                    file_crc = combine<model>(file_crc, checked.crc, checked.size);
+                });
+            return file_crc;
+        }
+
+        struct Options
+        {
+            //Index in CATALOGUE
+            std::size_t model = 0;
+            std::size_t block_size = BLOCK_SIZE;
+            unsigned threads = 1;
+        };
+
+        //Writes the header and the encoded blocks, returns the crc of the
+        //whole input
+        std::uint64_t encode(const std::filesystem::path& from, const std::filesystem::path& to,
+                             const Options& options = {});
+
+        //Checks a file with the model and block size of its header
+        std::uint64_t check(const std::filesystem::path& from, std::ostream& log, unsigned threads = 1);
+
+        struct DecodeOptions
+        {
+            unsigned threads = 1;
+            //Throw std::runtime_error on the first bad block instead of
+            //reporting it
+            bool abort = false;
+            //Fix blocks with a single bit error. Blocks where several bits
+            //would explain the crc are reported as failed
+            bool repair = false;
+        };
+
+        struct DecodeResult
+        {
+            //Crc of the written payload
+            std::uint64_t crc;
+            std::size_t failed;
+            std::size_t repaired;
+        };
+
+        //Strips the crcs while checking the blocks, so a restore reads the
+        //input once. Payloads of a task are written with a single call and
+        //bad blocks are reported to log, numbered from first_block
+        template <const Model& model>
+        DecodeResult decode(std::span<const char> data, std::ostream& output, std::ostream& log_stream,
+                            std::size_t block_size = BLOCK_SIZE, const DecodeOptions& options = {},
+                            std::size_t first_block = 0)
+        {
+            constexpr auto N = model.width;
+            constexpr auto Bytes = N/8;
+            using T = Register<N>;
+            const auto block_shift = zeros_operator<model>(block_size - Bytes);
+            const T empty = encode_span_sliced<model>({});
+            LazyLocator<model> locator(block_size);
+
+            struct Decoded
             {
-                check_and_log(std::span(block), i);
-                i++;
-            }
+                std::string data;
+                std::string log;
+                T crc;
+                std::size_t failed;
+                std::size_t repaired;
+            };
+
+            auto decode_task = [&](std::size_t first)
+            {
+                Decoded result{std::string(), std::string(), empty, 0, 0};
+                std::ostringstream log;
+                const auto end = std::min(data.size(), (first + TASK_BLOCKS) * block_size);
+                result.data.reserve(end - first * block_size);
+                for (std::size_t i = first; i * block_size < end; i++)
+                {
+                    const auto block = data.subspan(i * block_size, std::min(block_size, end - i * block_size));
+                    const auto stored = block.last(std::min(Bytes, block.size()));
+                    const auto payload = block.first(block.size() - stored.size());
+                    const auto offset = result.data.size();
+                    result.data.append(payload.data(), payload.size());
+
+                    T stored_crc = 0;
+                    for (const char c : stored)
+                        stored_crc = static_cast<T>((std::uintmax_t(stored_crc) << 8) | static_cast<unsigned char>(c));
+                    T crc = encode_span_fast<model>(payload);
+
+                    if (const T syndrome = crc ^ stored_crc)
+                    {
+                        const auto* found = options.repair ? locator.get() : nullptr;
+                        const auto distance = found ? found->locate(syndrome) : std::nullopt;
+                        const auto bit = distance ? block_bit(block.size(), *distance) : 0;
+                        //A flipped crc bit leaves the payload intact, a payload
+                        //flip is kept only when the crc matches after it
+                        bool repaired = distance && *distance < stored.size() * 8;
+                        if (distance && !repaired && *distance < block.size() * 8)
+                        {
+                            const auto repaired_payload = std::span<char>(result.data).subspan(offset, payload.size());
+                            repaired_payload[bit / 8] ^= static_cast<char>(1 << (bit % 8));
+                            repaired = encode_span_fast<model>(repaired_payload) == stored_crc;
+                            if (repaired)
+                                crc = stored_crc;
+                            else
+                                repaired_payload[bit / 8] ^= static_cast<char>(1 << (bit % 8));
+                        }
+
+                        if (repaired)
+                        {
+                            log << "Block " << first_block + i << " repaired at block bit " << bit << "\n";
+                            result.repaired++;
+                        }
+                        else if (options.abort)
+                        {
+                            throw std::runtime_error("Crc mismatch in block " + std::to_string(first_block + i));
+                        }
+                        else
+                        {
+                            log << "Block " << first_block + i << " failed: " << syndrome << "\n";
+                            result.failed++;
+                        }
+                    }
+
+                    result.crc = block.size() == block_size
+                        ? combine<model>(result.crc, crc, block_shift)
+                        : combine<model>(result.crc, crc, payload.size());
+                }
+                result.log = std::move(log).str();
+                return result;
+            };
+
+            std::size_t next = 0;
+            DecodeResult total{empty, 0, 0};
+            T file_crc = empty;
+            utils::ThreadPool pool(options.threads);
+            utils::ordered_for_each(
+                pool,
+                [&]() -> std::optional<std::size_t>
+                {
+                    if (next * block_size >= data.size())
+                        return std::nullopt;
+                    return std::exchange(next, next + TASK_BLOCKS);
+                },
+                decode_task,
+                [&](Decoded decoded)
+                {
+                    output.write(decoded.data.data(), decoded.data.size());
+                    log_stream << decoded.log << std::flush;
+                    file_crc = combine<model>(file_crc, decoded.crc, decoded.data.size());
+                    total.failed += decoded.failed;
+                    total.repaired += decoded.repaired;
+                });
+            total.crc = file_crc;
+            return total;
+        }
+
+        //Decodes a file with the model and block size of its header, to is
+        //removed when an abort stops the decode
+        DecodeResult decode(const std::filesystem::path& from, const std::filesystem::path& to,
+                            std::ostream& log, const DecodeOptions& options = {});
+
+        //Streaming variants, blocks are read in bounded chunks so the
+        //input does not have to be a file
+        std::uint64_t encode(std::istream& input, std::ostream& output, const Options& options = {});
+        DecodeResult decode(std::istream& input, std::ostream& output,
+                            std::ostream& log, const DecodeOptions& options = {});
 
-            if (input.gcount())
+        //Checks blocks and copies their payloads to output, which holds
+        //decoded_size bytes. Failed blocks are counted only
+        template <const Model& model>
+        DecodeResult decode(std::span<const char> data, std::span<char> output, std::size_t block_size)
+        {
+            constexpr auto Bytes = model.width / 8;
+            using T = Register<model.width>;
+            const auto block_shift = zeros_operator<model>(block_size - Bytes);
+
+            DecodeResult result{0, 0, 0};
+            T file_crc = encode_span_sliced<model>({});
+            char* out = output.data();
+            for (std::size_t offset = 0; offset < data.size(); offset += block_size)
             {
-                check_and_log(std::span(block.data(), input.gcount()), i);
+                const auto block = data.subspan(offset, std::min(block_size, data.size() - offset));
+                const auto stored = block.last(std::min(Bytes, block.size()));
+                const auto payload = block.first(block.size() - stored.size());
+                out = std::copy(payload.begin(), payload.end(), out);
+
+                T stored_crc = 0;
+                for (const char c : stored)
+                    stored_crc = static_cast<T>((std::uintmax_t(stored_crc) << 8) | static_cast<unsigned char>(c));
+                const T crc = encode_span_fast<model>(payload);
+                result.failed += crc != stored_crc;
+                file_crc = block.size() == block_size
+                    ? combine<model>(file_crc, crc, block_shift)
+                    : combine<model>(file_crc, crc, payload.size());
             }
+            result.crc = file_crc;
+            return result;
         }
 
-        template <const auto& poly>
-        void decode(const std::filesystem::path& from,
-                    const std::filesystem::path& to)
+        //In memory variants with the header of the file format. Blocks are
+        //coded on the calling thread and nothing is allocated, so buffers
+        //kept by the caller code any number of inputs without the heap.
+        //Output of encode holds HEADER_SIZE + encoded_size bytes, too small
+        //buffers throw std::invalid_argument
+        std::uint64_t encode(std::span<const std::byte> input, std::span<std::byte> output,
+                             const Options& options = {});
+        std::size_t decoded_size(std::span<const std::byte> input);
+        DecodeResult decode(std::span<const std::byte> input, std::span<std::byte> output);
+
+        //Payload bytes changed since encoding
+        struct Range
         {
-            constexpr auto N = poly.size();
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+
+        //Brings encoded blocks in line with input by rewriting in place
+        //only blocks covered by ranges, or without ranges the blocks whose
+        //payload differs, and every block past the common length so an
+        //append starts at the last partial block. Blocks are written at
+        //offset in output, returns the number of blocks rewritten
+        template <const Model& model>
+        std::size_t update(std::span<const char> input, std::span<const char> encoded,
+                           std::ostream& output, std::uint64_t offset,
+                           std::size_t block_size, std::span<const Range> ranges)
+        {
+            constexpr auto N = model.width;
             constexpr auto Bytes = N/8;
-            std::ifstream input(from, std::ios::binary);
-            std::ofstream output(to, std::ios::binary);
-            std::array<char, BLOCK_SIZE> block;
+            const auto payload_size = block_size - Bytes;
 
-            while(input.read(block.data(), block.size()))
+            const std::uint64_t full = encoded.size() / block_size;
+            const std::uint64_t rest = encoded.size() % block_size;
+            const std::uint64_t old_size = full * payload_size + (rest > Bytes ? rest - Bytes : 0);
+            const std::uint64_t common = std::min<std::uint64_t>(old_size, input.size());
+            const std::uint64_t blocks = (input.size() + payload_size - 1) / payload_size;
+
+            //Blocks from the one holding the end of the shorter payload on
+            std::vector<bool> changed(blocks);
+            if (old_size != input.size())
+            {
+                for (std::uint64_t b = common / payload_size; b < blocks; b++)
+                    changed[b] = true;
+            }
+
+            if (ranges.empty())
+            {
+                for (std::uint64_t b = 0; b * payload_size < common; b++)
+                {
+                    const auto size = std::min<std::uint64_t>(payload_size, common - b * payload_size);
+                    const auto old_payload = encoded.subspan(b * block_size, size);
+                    if (!std::ranges::equal(old_payload, input.subspan(b * payload_size, size)))
+                        changed[b] = true;
+                }
+            }
+            for (const auto& range : ranges)
             {
-                output.write(block.data(), block.size() - Bytes);
+                const auto end = std::min<std::uint64_t>(range.offset + range.size, input.size());
+                for (std::uint64_t b = range.offset / payload_size; b * payload_size < end; b++)
+                    changed[b] = true;
             }
-            output.write(block.data(), input.gcount() - Bytes);
+
+            std::size_t rewritten = 0;
+            std::string block;
+            for (std::uint64_t b = 0; b < blocks; b++)
+            {
+                if (!changed[b])
+                    continue;
+
+                const auto payload = input.subspan(b * payload_size,
+                    std::min<std::uint64_t>(payload_size, input.size() - b * payload_size));
+                const auto crc = encode_span_fast<model>(payload);
+                block.assign(payload.data(), payload.size());
+                for (std::size_t i = Bytes; i != 0; i--)
+                    block.push_back(static_cast<char>(crc >> ((i - 1) * 8)));
+
+                output.seekp(offset + b * block_size);
+                output.write(block.data(), block.size());
+                rewritten++;
+            }
+            return rewritten;
         }
+
+        //Size of the encoded blocks for size payload bytes
+        std::uint64_t encoded_size(std::uint64_t size, const Header& header);
+        //Payload bytes of size bytes of encoded blocks
+        std::uint64_t decoded_size(std::uint64_t size, const Header& header);
+
+        //Updates the encoded file of from in place, truncating it when
+        //from got shorter
+        std::size_t update(const std::filesystem::path& from, const std::filesystem::path& encoded,
+                           std::span<const Range> ranges = {});
     }
 }
@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TIK_CRC_CLMUL 1
+#include <immintrin.h>
+#else
+#define TIK_CRC_CLMUL 0
+#endif
+
+namespace tik
+{
+    namespace crc
+    {
+        //Carry-less multiplication folding for msb first crcs. The message
+        //is folded 16 bytes at a time into a 128 bit remainder congruent to
+        //it modulo the polynomial; the remainder still has to go through
+        //a crc engine, which keeps the final reduction in one place
+        namespace clmul
+        {
+            //Shorter spans are left to the table engines
+            constexpr std::size_t MIN_SIZE = 64;
+
+            //x^k mod (x^N + poly)
+            constexpr std::uint64_t x_pow_mod(std::size_t k, std::uint64_t poly, std::size_t N)
+            {
+                const std::uint64_t top = std::uint64_t(1) << (N - 1);
+                const std::uint64_t mask = N == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << N) - 1;
+                std::uint64_t result = 1;
+                for (std::size_t i = 0; i < k; i++)
+                {
+                    const bool carry = result & top;
+                    result = (result << 1) & mask;
+                    if (carry)
+                        result ^= poly;
+                }
+                return result;
+            }
+
+#if TIK_CRC_CLMUL
+            inline bool supported()
+            {
+                static const bool result = __builtin_cpu_supports("pclmul")
+                    && __builtin_cpu_supports("ssse3");
+                return result;
+            }
+
+            //A * x^D for a distance D given as {x^(D + 64), x^D} mod poly
+            __attribute__((target("pclmul,ssse3")))
+            inline __m128i fold(__m128i value, __m128i constants)
+            {
+                return _mm_xor_si128(_mm_clmulepi64_si128(value, constants, 0x11),
+                                     _mm_clmulepi64_si128(value, constants, 0x00));
+            }
+
+            //Loads 16 bytes with the first one in the highest byte
+            __attribute__((target("pclmul,ssse3")))
+            inline __m128i load(const char* data)
+            {
+                const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                                     8, 9, 10, 11, 12, 13, 14, 15);
+                return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), reverse);
+            }
+
+            //Folds whole 16 byte blocks of span, span.size() >= MIN_SIZE. The
+            //crc register is added to the front of the message. Writes the
+            //remainder in message byte order and returns bytes folded
+            template <std::uint64_t poly, std::size_t N>
+            __attribute__((target("pclmul,ssse3")))
+            std::size_t fold_span(std::uint64_t crc, std::span<const char> span,
+                                  std::array<char, 16>& remainder)
+            {
+                static_assert(N % 8 == 0 && N <= 64);
+                constexpr auto k128 = x_pow_mod(128, poly, N);
+                constexpr auto k192 = x_pow_mod(192, poly, N);
+                constexpr auto k512 = x_pow_mod(512, poly, N);
+                constexpr auto k576 = x_pow_mod(576, poly, N);
+                const __m128i fold128 = _mm_set_epi64x(static_cast<long long>(k192),
+                                                       static_cast<long long>(k128));
+                const __m128i fold512 = _mm_set_epi64x(static_cast<long long>(k576),
+                                                       static_cast<long long>(k512));
+
+                const char* data = span.data();
+                constexpr std::size_t ACCUMULATORS = 4;
+                __m128i acc[ACCUMULATORS];
+                for (std::size_t i = 0; i < ACCUMULATORS; i++)
+                    acc[i] = load(data + 16 * i);
+                acc[0] = _mm_xor_si128(acc[0], _mm_set_epi64x(static_cast<long long>(crc << (64 - N)), 0));
+
+                //Four independent accumulators hide the multiply latency
+                std::size_t pos = 64;
+                for (; pos + 64 <= span.size(); pos += 64)
+                {
+                    for (std::size_t i = 0; i < ACCUMULATORS; i++)
+                        acc[i] = _mm_xor_si128(fold(acc[i], fold512), load(data + pos + 16 * i));
+                }
+
+                __m128i result = acc[0];
+                for (std::size_t i = 1; i < ACCUMULATORS; i++)
+                    result = _mm_xor_si128(fold(result, fold128), acc[i]);
+                for (; pos + 16 <= span.size(); pos += 16)
+                    result = _mm_xor_si128(fold(result, fold128), load(data + pos));
+
+                const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                                     8, 9, 10, 11, 12, 13, 14, 15);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(remainder.data()),
+                                 _mm_shuffle_epi8(result, reverse));
+                return pos;
+            }
+#else
+            inline bool supported()
+            {
+                return false;
+            }
+#endif
+        }
+    }
+}
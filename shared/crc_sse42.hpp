@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TIK_CRC_SSE42 1
+#include <immintrin.h>
+#else
+#define TIK_CRC_SSE42 0
+#endif
+
+namespace tik
+{
+    namespace crc
+    {
+        //The SSE4.2 crc32 instruction: a reflected crc with the Castagnoli
+        //polynomial, run on the register without init and xorout
+        namespace sse42
+        {
+            constexpr std::uint64_t POLY = 0x1EDC6F41;
+
+#if TIK_CRC_SSE42
+            inline bool supported()
+            {
+                static const bool result = __builtin_cpu_supports("sse4.2");
+                return result;
+            }
+
+            __attribute__((target("sse4.2")))
+            inline std::uint32_t update(std::uint32_t crc, std::span<const char> span)
+            {
+                const char* data = span.data();
+                std::size_t size = span.size();
+
+                std::uint64_t wide = crc;
+                for (; size >= sizeof(std::uint64_t); data += sizeof(std::uint64_t), size -= sizeof(std::uint64_t))
+                {
+                    std::uint64_t word;
+                    std::memcpy(&word, data, sizeof(word));
+                    wide = _mm_crc32_u64(wide, word);
+                }
+
+                crc = static_cast<std::uint32_t>(wide);
+                for (; size; ++data, --size)
+                    crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+                return crc;
+            }
+#else
+            inline bool supported()
+            {
+                return false;
+            }
+#endif
+        }
+    }
+}
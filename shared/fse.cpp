@@ -0,0 +1,300 @@
+#include "fse.hpp"
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+
+namespace tik
+{
+    FseCoder::Normalized FseCoder::normalize(const CodeTree::Counts& counts, unsigned table_log)
+    {
+        if (table_log < MIN_TABLE_LOG || table_log > MAX_TABLE_LOG)
+            throw std::invalid_argument("Unsupported table log");
+
+        const std::uint64_t total = std::accumulate(counts.begin(), counts.end(), std::uint64_t(0));
+        if (total == 0)
+            throw std::invalid_argument("Nothing to normalize");
+
+        const std::uint64_t size = std::uint64_t(1) << table_log;
+        Normalized normalized{};
+
+        //Symbols too rare for a cell of their own get one, the rest of the
+        //table is shared by the others in proportion to their counts
+        std::uint64_t cells = size;
+        std::uint64_t mass = total;
+        for (std::size_t i = 0; i < counts.size(); ++i)
+        {
+            if (counts[i] && counts[i] * size < total)
+            {
+                normalized[i] = 1;
+                --cells;
+                mass -= counts[i];
+            }
+        }
+
+        //Floors first, then cells left by rounding go to the largest
+        //fractional parts
+        std::array<std::pair<std::uint64_t, std::size_t>, 256> remainders;
+        std::size_t num_remainders = 0;
+        std::int64_t left = cells;
+        for (std::size_t i = 0; i < counts.size(); ++i)
+        {
+            if (!counts[i] || normalized[i])
+                continue;
+
+            const std::uint64_t scaled = counts[i] * cells;
+            const std::uint64_t count = std::max<std::uint64_t>(1, scaled / mass);
+            normalized[i] = static_cast<std::uint16_t>(count);
+            left -= count;
+            remainders[num_remainders++] = {scaled % mass, i};
+        }
+
+        std::sort(remainders.begin(), remainders.begin() + num_remainders, std::greater<>());
+        for (std::size_t k = 0; left > 0; --left, ++k)
+            ++normalized[remainders[k % num_remainders].second];
+
+        //Raising counts to 1 may overdraw the table, the most frequent
+        //symbols lose the least ratio per cell. Symbols are at most 256 so
+        //the largest count never drops to zero
+        for (; left < 0; ++left)
+            --*std::ranges::max_element(normalized);
+
+        return normalized;
+    }
+
+    void FseCoder::serialize(const Normalized& normalized, unsigned table_log, std::ostream& out)
+    {
+        std::array<char, MAX_HEADER_SIZE> header;
+        out.write(header.data(), serialize(normalized, table_log, header));
+    }
+
+    std::size_t FseCoder::serialize(const Normalized& normalized, unsigned table_log, std::span<char> out)
+    {
+        out[0] = static_cast<char>(table_log);
+
+        const auto present = out.subspan(1, 256 / 8);
+        std::fill(present.begin(), present.end(), '\0');
+        for (std::size_t i = 0; i < normalized.size(); ++i)
+        {
+            if (normalized[i])
+                present[i / 8] |= static_cast<char>(1 << (i % 8));
+        }
+
+        std::size_t pos = 1 + present.size();
+        for (const auto count : normalized)
+        {
+            if (count)
+            {
+                out[pos++] = static_cast<char>(count);
+                out[pos++] = static_cast<char>(count >> 8);
+            }
+        }
+        return pos;
+    }
+
+    FseCoder::Normalized FseCoder::deserialize(std::span<const char> in, unsigned& table_log,
+                                               std::size_t& used)
+    {
+        constexpr std::size_t PRESENT_BYTES = 256 / 8;
+        if (in.size() < 1 + PRESENT_BYTES)
+            throw std::invalid_argument("Unexpected end of FSE header");
+
+        table_log = static_cast<unsigned char>(in[0]);
+        if (table_log < MIN_TABLE_LOG || table_log > MAX_TABLE_LOG)
+            throw std::invalid_argument("Unsupported table log");
+
+        Normalized normalized{};
+        std::size_t pos = 1 + PRESENT_BYTES;
+        for (std::size_t i = 0; i < normalized.size(); ++i)
+        {
+            if (!((static_cast<unsigned char>(in[1 + i / 8]) >> (i % 8)) & 1))
+                continue;
+
+            if (pos + 2 > in.size())
+                throw std::invalid_argument("Unexpected end of FSE header");
+            normalized[i] = static_cast<std::uint16_t>(static_cast<unsigned char>(in[pos])
+                | static_cast<unsigned char>(in[pos + 1]) << 8);
+            pos += 2;
+        }
+
+        used = pos;
+        return normalized;
+    }
+
+    FseCoder::FseCoder(const Normalized& normalized, unsigned table_log)
+    {
+        reset(normalized, table_log);
+    }
+
+    void FseCoder::reset(const Normalized& normalized, unsigned table_log)
+    {
+        if (table_log < MIN_TABLE_LOG || table_log > MAX_TABLE_LOG)
+            throw std::invalid_argument("Unsupported table log");
+
+        const unsigned size = 1u << table_log;
+        if (std::accumulate(normalized.begin(), normalized.end(), 0u) != size)
+            throw std::invalid_argument("Normalized counts do not sum to the table size");
+
+        m_table_log = table_log;
+        m_normalized = normalized;
+        m_transforms = {};
+
+        //Cells of a symbol are scattered over the table, the step is odd so
+        //every cell is visited once
+        std::array<char, 1u << MAX_TABLE_LOG> spread;
+        const unsigned step = (size >> 1) + (size >> 3) + 3;
+        unsigned pos = 0;
+        for (std::size_t i = 0; i < normalized.size(); ++i)
+        {
+            for (unsigned k = 0; k < normalized[i]; ++k)
+            {
+                spread[pos] = static_cast<char>(i);
+                pos = (pos + step) & (size - 1);
+            }
+        }
+
+        std::array<unsigned, 257> cumulative{};
+        for (std::size_t i = 0; i < normalized.size(); ++i)
+            cumulative[i + 1] = cumulative[i] + normalized[i];
+
+        //The k-th cell of a symbol with count n is reached from states
+        //x = n + k, decoding shifts x back up to the table range
+        m_decode.resize(size);
+        m_states.resize(size);
+        std::array<unsigned, 256> next;
+        std::copy(normalized.begin(), normalized.end(), next.begin());
+        for (unsigned cell = 0; cell < size; ++cell)
+        {
+            const auto symbol = static_cast<unsigned char>(spread[cell]);
+            const unsigned x = next[symbol]++;
+            const unsigned bits = table_log + 1 - std::bit_width(x);
+            m_decode[cell] = DecodeEntry{static_cast<std::uint16_t>((x << bits) - size),
+                spread[cell], static_cast<std::uint8_t>(bits)};
+            m_states[cumulative[symbol] + x - normalized[symbol]] = static_cast<std::uint16_t>(cell + size);
+        }
+
+        //A state in [size, 2 * size) outputs max_bits for a symbol with
+        //count n when it is at least n << max_bits, one bit less otherwise
+        for (std::size_t i = 0; i < normalized.size(); ++i)
+        {
+            const unsigned count = normalized[i];
+            if (!count)
+                continue;
+
+            const unsigned max_bits = table_log + 1 - std::bit_width(count - 1);
+            m_transforms[i].delta_bits = (max_bits << 16) - (count << max_bits);
+            m_transforms[i].delta_state = static_cast<std::int32_t>(cumulative[i])
+                - static_cast<std::int32_t>(count);
+        }
+    }
+
+    std::size_t FseCoder::max_encoded_size(std::size_t size) const
+    {
+        return max_encoded_size(size, m_table_log);
+    }
+
+    std::size_t FseCoder::max_encoded_size(std::size_t size, unsigned table_log)
+    {
+        //Flushes may store a whole word past the last byte
+        return ((size + STATES) * table_log + 7) / 8 + 2 * sizeof(std::uint64_t);
+    }
+
+    void FseCoder::encode(std::span<const char> in, utils::BufferBitWriter& writer) const
+    {
+        std::vector<std::uint32_t> symbol_bits;
+        encode(in, writer, symbol_bits);
+    }
+
+    void FseCoder::encode(std::span<const char> in, utils::BufferBitWriter& writer,
+                          std::vector<std::uint32_t>& symbol_bits) const
+    {
+        const std::uint32_t size = 1u << m_table_log;
+
+        //Symbols are coded last to first, so their bits are kept and
+        //written in the order the decoder reads them
+        symbol_bits.resize(in.size());
+        auto encode_symbol = [&](std::size_t i, std::uint32_t& state)
+        {
+            const auto c = static_cast<unsigned char>(in[i]);
+            if (!m_normalized[c])
+                throw std::out_of_range("No count for symbol");
+
+            const auto& transform = m_transforms[c];
+            const unsigned bits = (state + transform.delta_bits) >> 16;
+            symbol_bits[i] = (state & ((1u << bits) - 1)) | (bits << 16);
+            state = m_states[(state >> bits) + transform.delta_state];
+        };
+
+        static_assert(STATES == 2);
+        std::uint32_t even = size;
+        std::uint32_t odd = size;
+        std::size_t i = in.size();
+        if (i % 2)
+            encode_symbol(--i, even);
+        for (; i; i -= 2)
+        {
+            encode_symbol(i - 1, odd);
+            encode_symbol(i - 2, even);
+        }
+
+        writer.write(even - size, m_table_log);
+        writer.write(odd - size, m_table_log);
+        writer.flush();
+
+        //After a flush at most 7 bits are pending, a group of symbols with
+        //at most MAX_TABLE_LOG bits each fits before the next store
+        constexpr std::size_t GROUP = 56 / MAX_TABLE_LOG;
+        for (i = 0; i + GROUP <= symbol_bits.size(); i += GROUP)
+        {
+            for (std::size_t k = 0; k < GROUP; ++k)
+                writer.put(symbol_bits[i + k] & 0xFFFF, symbol_bits[i + k] >> 16);
+            writer.flush();
+        }
+        for (; i < symbol_bits.size(); ++i)
+            writer.write(symbol_bits[i] & 0xFFFF, symbol_bits[i] >> 16);
+    }
+
+    std::uint64_t FseCoder::decode(std::span<const char> in, std::span<char> out) const
+    {
+        //Every symbol takes at most MAX_TABLE_LOG bits, a refill covers a
+        //group that alternates between the states
+        constexpr std::size_t GROUP = 56 / MAX_TABLE_LOG;
+        static_assert(STATES == 2 && GROUP % STATES == 0);
+
+        utils::BufferBitReader reader(in);
+        const DecodeEntry* const table = m_decode.data();
+        reader.refill();
+        unsigned even = static_cast<unsigned>(reader.read(m_table_log));
+        unsigned odd = static_cast<unsigned>(reader.read(m_table_log));
+
+        auto step = [&](unsigned& state, char& symbol)
+        {
+            const DecodeEntry entry = table[state];
+            symbol = entry.symbol;
+            state = entry.next_state + static_cast<unsigned>(reader.peek(entry.bits));
+            reader.consume(entry.bits);
+        };
+
+        char* it = out.data();
+        char* const end = out.data() + out.size();
+        for (; end - it >= static_cast<std::ptrdiff_t>(GROUP); it += GROUP)
+        {
+            reader.refill();
+            for (std::size_t k = 0; k < GROUP; k += STATES)
+            {
+                step(even, it[k]);
+                step(odd, it[k + 1]);
+            }
+        }
+        reader.refill();
+        for (std::size_t k = 0; it != end; ++it, ++k)
+            step(k % 2 ? odd : even, *it);
+
+        //Encoding starts from the first cell, any other end state means
+        //the stream was damaged
+        if (even != 0 || odd != 0)
+            throw std::invalid_argument("Corrupted FSE stream");
+        return reader.position();
+    }
+}
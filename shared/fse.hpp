@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <vector>
+#include "bit_buffer.hpp"
+#include "tree.hpp"
+
+namespace tik
+{
+    //Table based asymmetric numeral system (tANS) coder. Symbol counts are
+    //normalized to sum to 2^table_log, the coder state selects a cell of a
+    //table of that size and carries fractional bits between symbols, so
+    //probabilities are not rounded to whole bit code lengths
+    class FseCoder
+    {
+    public:
+        static constexpr unsigned MIN_TABLE_LOG = 8;
+        static constexpr unsigned MAX_TABLE_LOG = 12;
+        static constexpr unsigned DEFAULT_TABLE_LOG = 12;
+        //Even and odd symbols are coded with separate states so decoding
+        //does not wait on a single state chain
+        static constexpr unsigned STATES = 2;
+
+        using Normalized = std::array<std::uint16_t, 256>;
+
+        //Bytes written by serialize at most
+        static constexpr std::size_t MAX_HEADER_SIZE = 1 + 256 / 8 + 2 * 256;
+
+        //Every present symbol keeps a count of at least 1
+        static Normalized normalize(const CodeTree::Counts& counts,
+                                    unsigned table_log = DEFAULT_TABLE_LOG);
+
+        //Table log, a bitmap of present symbols and their counts
+        static void serialize(const Normalized& normalized, unsigned table_log, std::ostream& out);
+        //Returns the bytes written, out holds at least MAX_HEADER_SIZE bytes
+        static std::size_t serialize(const Normalized& normalized, unsigned table_log, std::span<char> out);
+        static Normalized deserialize(std::span<const char> in, unsigned& table_log,
+                                      std::size_t& used);
+
+        //Has no table until reset
+        FseCoder() = default;
+        FseCoder(const Normalized& normalized, unsigned table_log);
+
+        //Rebuilds the tables for other counts, reusing their memory
+        void reset(const Normalized& normalized, unsigned table_log);
+
+        //Upper bound of bytes written by encode for size input bytes
+        std::size_t max_encoded_size(std::size_t size) const;
+        static std::size_t max_encoded_size(std::size_t size, unsigned table_log);
+
+        //Writes the final coder states and the bits of every symbol in
+        //decoding order. Throws std::out_of_range for bytes with zero count
+        void encode(std::span<const char> in, utils::BufferBitWriter& writer) const;
+        //Keeps the bits of every symbol in symbol_bits, so a caller coding
+        //many buffers does not allocate for each of them
+        void encode(std::span<const char> in, utils::BufferBitWriter& writer,
+                    std::vector<std::uint32_t>& symbol_bits) const;
+
+        //Decodes out.size() symbols, returns the number of bits consumed
+        std::uint64_t decode(std::span<const char> in, std::span<char> out) const;
+
+    private:
+        struct DecodeEntry
+        {
+            std::uint16_t next_state;
+            char symbol;
+            std::uint8_t bits;
+        };
+
+        struct SymbolTransform
+        {
+            //High 16 bits of state + delta_bits give the bits to output
+            std::uint32_t delta_bits;
+            std::int32_t delta_state;
+        };
+
+        unsigned m_table_log = 0;
+        Normalized m_normalized{};
+        std::vector<DecodeEntry> m_decode;
+        std::vector<std::uint16_t> m_states;
+        std::array<SymbolTransform, 256> m_transforms{};
+    };
+}
@@ -1,174 +1,860 @@
 #include "hamming.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <bitset>
+#include <cstring>
 #include <fstream>
-#include "bit_getter.hpp"
-#include "bit_writer.hpp"
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <vector>
+#include "bit_buffer.hpp"
+#include "hamming_screen.hpp"
+#include "mapped_file.hpp"
+#include "secded.hpp"
+#include "thread_pool.hpp"
 
 namespace tik
 {
     namespace hamming
     {
-        enum class Type
+        namespace
         {
-            NORMAL,
-            EXTENDED
-        };
+            //Bytes of input read at once, whole 88 bit groups of 8 codewords
+            constexpr std::size_t ENCODE_BLOCK = 11 * 6144;
+            constexpr std::size_t DECODE_BLOCK = 2 * 8 * 6144;
 
-        void encode(const std::filesystem::path& from,
-                    const std::filesystem::path& to)
-        {
-            std::ifstream input(from, std::ios::binary);
-            std::ofstream output(to, std::ios::binary);
+            //(16, 11) is the 11 bit member of the family, (15, 11) drops the
+            //overall parity
+            constexpr std::uint16_t encode_word(unsigned data, Type type)
+            {
+                const auto out = static_cast<std::uint16_t>(Secded<11>::pack(static_cast<std::uint16_t>(data)));
+                return type == Type::EXTENDED ? out : static_cast<std::uint16_t>(out & ~1u);
+            }
 
-            output.put(char(Type::EXTENDED));
+            //Codeword of every 11 bit data word
+            constexpr std::array<std::uint16_t, 2048> build_encode_table(Type type)
+            {
+                std::array<std::uint16_t, 2048> result{};
+                for (unsigned i = 0; i < result.size(); ++i)
+                    result[i] = encode_word(i, type);
+                return result;
+            }
 
-            utils::BitGetter bit_getter(input);
+            constexpr auto NORMAL_TABLE = build_encode_table(Type::NORMAL);
+            constexpr auto EXTENDED_TABLE = build_encode_table(Type::EXTENDED);
 
-            while (bit_getter)
+            //Encodes bits of block into codewords. Bits past the end of
+            //the block are ones, as utils::BitGetter reads them past EOF
+            void encode_block(std::span<const char> block, std::size_t num_codewords,
+                              Type type, char* out)
             {
-                std::bitset<4> code;
-                std::bitset<16> out;
+                const auto& table = type == Type::EXTENDED ? EXTENDED_TABLE : NORMAL_TABLE;
 
-                for (unsigned i = 0; i < 11; ++i)
+                //11 bytes hold exactly 8 data words, read as one 64 bit and
+                //one 24 bit little endian part
+                std::size_t i = 0;
+                const std::size_t groups = std::min(block.size() / 11, num_codewords / 8);
+                for (std::size_t g = 0; g < groups; ++g, i += 8)
                 {
-                    if (bit_getter.get())
-                    {
-                        unsigned mapped;
-                        if (i == 0)
-                            mapped = 3;
-                        else if (i < 4)
-                            mapped = i + 4;
-                        else
-                            mapped = i + 5;
-
-                        out[mapped] = true;
-                        code ^= mapped;
+                    const char* in = block.data() + g * 11;
+                    const std::uint64_t low = utils::load_u64_le(in);
+                    const std::uint64_t high = static_cast<unsigned char>(in[8])
+                        | static_cast<unsigned char>(in[9]) << 8
+                        | static_cast<unsigned char>(in[10]) << 16;
+
+                    std::array<std::uint16_t, 8> words;
+                    for (unsigned k = 0; k < 5; ++k)
+                        words[k] = table[(low >> (11 * k)) & 0x7FF];
+                    words[5] = table[((low >> 55) | (high << 9)) & 0x7FF];
+                    words[6] = table[(high >> 2) & 0x7FF];
+                    words[7] = table[(high >> 13) & 0x7FF];
+                    std::memcpy(out + i * sizeof(std::uint16_t), words.data(), sizeof(words));
+                }
+
+                utils::BufferBitReader reader(block.subspan(groups * 11));
+                const std::uint64_t total_bits = block.size() * 8;
+                for (; i < num_codewords; ++i)
+                {
+                    unsigned data = reader.read(11);
+                    const std::uint64_t start = i * 11;
+                    if (start + 11 > total_bits)
+                    {
+                        const unsigned valid = total_bits > start ? total_bits - start : 0;
+                        data |= 0x7FF & ~((1u << valid) - 1);
                     }
+
+                    const std::uint16_t o = table[data];
+                    std::memcpy(out + i * sizeof(o), &o, sizeof(o));
                 }
-                out[1] = code[0];
-                out[2] = code[1];
-                out[4] = code[2];
-                out[8] = code[3];
+            }
 
-                out[0] = out.count() % 2;
-                uint16_t o = out.to_ulong();
-                output.write(reinterpret_cast<const char*>(&o), sizeof(o));
+            //Syndrome of a codeword, the index of a single flipped bit
+            unsigned syndrome(std::uint16_t codeword)
+            {
+                unsigned result = 0;
+                for (unsigned j = 0; j < screen::SYNDROME_MASKS.size(); ++j)
+                    result |= (std::popcount<std::uint16_t>(codeword & screen::SYNDROME_MASKS[j]) & 1) << j;
+                return result;
             }
-        }
 
-        void encode_not_extended(const std::filesystem::path& from,
-                                 const std::filesystem::path& to)
-        {
-            std::ifstream input(from, std::ios::binary);
-            std::ofstream output(to, std::ios::binary);
+            constexpr unsigned extract_data(std::uint16_t codeword)
+            {
+                return ((codeword >> 3) & 0x1) | ((codeword >> 4) & 0xE) | ((codeword >> 5) & 0x7F0);
+            }
 
-            output.put(char(Type::NORMAL));
+            //Marks decode table entries of detected double errors
+            constexpr std::uint16_t DOUBLE_ERROR = 0x8000;
 
-            utils::BitGetter bit_getter(input);
+            //Corrected data of every codeword
+            std::vector<std::uint16_t> build_decode_table(Type type)
+            {
+                std::vector<std::uint16_t> result(1 << 16);
+                for (unsigned i = 0; i < result.size(); ++i)
+                {
+                    std::uint16_t codeword = static_cast<std::uint16_t>(i);
+                    const unsigned flip = syndrome(codeword);
+                    std::uint16_t flags = 0;
+                    if (type == Type::NORMAL)
+                    {
+                        codeword ^= 1u << flip;
+                    }
+                    else if (type == Type::EXTENDED)
+                    {
+                        if (std::popcount(codeword) % 2)
+                            codeword ^= 1u << flip;
+                        else if (flip)
+                            flags = DOUBLE_ERROR;
+                    }
+                    result[i] = static_cast<std::uint16_t>(extract_data(codeword) | flags);
+                }
+                return result;
+            }
 
-            while (bit_getter)
+            const std::vector<std::uint16_t>& decode_table(Type type)
             {
-                std::bitset<4> code;
-                std::bitset<16> out;
+                static const std::array<std::vector<std::uint16_t>, 3> tables = {
+                    build_decode_table(Type::NORMAL), build_decode_table(Type::EXTENDED),
+                    build_decode_table(Type::LEGACY)};
+                return tables[static_cast<std::size_t>(type)];
+            }
 
-                for (unsigned i = 0; i < 11; ++i)
+            std::uint16_t load_codeword(const char* data)
+            {
+                std::uint16_t codeword;
+                std::memcpy(&codeword, data, sizeof(codeword));
+                return codeword;
+            }
+
+            //A block of the input stream handled by one task
+            struct Block
+            {
+                std::vector<char> data;
+                //Bytes of the stream before the block
+                std::uint64_t offset = 0;
+                //Set for the block after which the stream ended
+                bool last = false;
+            };
+
+            //Reads input in blocks of block_size, process fills a Result
+            //of every block on threads and consume gets them in stream
+            //order. The last block may be empty when the stream size is a
+            //multiple of block_size. Returns the number of bytes read
+            template <typename Result, typename Process, typename Consume>
+            std::uint64_t for_each_block(std::istream& input, std::size_t block_size, unsigned threads,
+                                Process process, Consume consume)
+            {
+                std::uint64_t offset = 0;
+                bool done = false;
+                auto read_block = [&](Block& block)
+                {
+                    if (done)
+                        return false;
+
+                    block.data.resize(block_size);
+                    input.read(block.data.data(), block.data.size());
+                    block.data.resize(input.gcount());
+                    block.offset = offset;
+                    block.last = done = block.data.size() < block_size || !input;
+                    offset += block.data.size();
+                    return true;
+                };
+
+                //A single thread gains nothing from handing blocks over and
+                //reuses the buffers of the previous block
+                if (threads <= 1)
                 {
-                    if (bit_getter.get())
-                    {
-                        unsigned mapped;
-                        if (i == 0)
-                            mapped = 3;
-                        else if (i < 4)
-                            mapped = i + 4;
-                        else
-                            mapped = i + 5;
-
-                        out[mapped] = true;
-                        code ^= mapped;
+                    Block block;
+                    Result result;
+                    while (read_block(block))
+                    {
+                        process(block, result);
+                        consume(result);
                     }
+                    return offset;
                 }
-                out[1] = code[0];
-                out[2] = code[1];
-                out[4] = code[2];
-                out[8] = code[3];
-                uint16_t o = out.to_ulong();
-                output.write(reinterpret_cast<const char*>(&o), sizeof(o));
+
+                utils::ThreadPool pool(threads);
+                utils::ordered_for_each(
+                    pool,
+                    [&]() -> std::optional<Block>
+                    {
+                        Block block;
+                        if (!read_block(block))
+                            return std::nullopt;
+                        return block;
+                    },
+                    [&process](Block block)
+                    {
+                        Result result;
+                        process(block, result);
+                        return result;
+                    },
+                    [&consume](Result result)
+                    {
+                        consume(result);
+                    });
+                return offset;
             }
-        }
 
-        void decode(const std::filesystem::path& from,
-                    const std::filesystem::path& to)
-        {
-            std::ifstream input(from, std::ios::binary);
-            std::ofstream output(to, std::ios::binary);
+            //Decoded bytes of a block and the number of double errors seen
+            struct Decoded
+            {
+                std::vector<char> data;
+                std::size_t double_errors = 0;
+            };
 
-            utils::BitWriter bit_writer(output);
-            bit_writer.discard_last() = true;
+            void report(std::size_t double_errors)
+            {
+                for (std::size_t i = 0; i < double_errors; ++i)
+                    std::cerr << "double error" << std::endl;
+            }
 
-            unsigned char type_char = input.get();
-            if (type_char > 2)
+            //Encodes the (15, 11) and (16, 11) codes, codewords follow each
+            //other with no regard for byte boundaries of the input. Blocks
+            //hold whole 88 bit groups, so they are encoded independently
+            void encode_packed(std::istream& input, std::ostream& output, Type type, unsigned threads)
             {
-                std::cerr << "Unknown type" << std::endl;
-                throw std::exception();
+                for_each_block<std::vector<char>>(input, ENCODE_BLOCK, threads,
+                    [type](const Block& block, std::vector<char>& encoded)
+                    {
+                        std::size_t num_codewords = block.data.size() * 8 / 11;
+                        //The original encoder always emits one more codeword
+                        //after the last whole one of a nonempty input
+                        if (block.last)
+                            num_codewords = block.offset + block.data.size() ? num_codewords + 1 : 0;
+                        encoded.resize(num_codewords * sizeof(std::uint16_t));
+                        encode_block(block.data, num_codewords, type, encoded.data());
+                    },
+                    [&](const std::vector<char>& encoded)
+                    {
+                        output.write(encoded.data(), encoded.size());
+                    });
             }
 
-            Type type = static_cast<Type>(type_char);
+            //Bytes of codewords for size bytes of a word aligned code
+            template <unsigned DataBits>
+            constexpr std::size_t words_size(std::size_t size)
+            {
+                constexpr std::size_t WORD = DataBits / 8;
+                return (size + WORD - 1) / WORD * (WORD + 1);
+            }
 
-            uint16_t current;
-            while(input.read(reinterpret_cast<char*>(&current), sizeof(current)))
+            //Word aligned codes store every data word as is followed by a
+            //byte of check bits, the last word is padded with zeros
+            template <unsigned DataBits>
+            void encode_span(std::span<const char> data, char* out)
             {
-                std::bitset<sizeof(current) * 8> current_set = current;
+                using Code = Secded<DataBits>;
+                constexpr std::size_t WORD = DataBits / 8;
 
-                std::size_t flip = 0;
-                for (std::size_t i = 0; i < current_set.size(); ++i)
+                std::array<char, WORD> tail{};
+                const std::size_t whole = data.size() / WORD * WORD;
+                std::memcpy(tail.data(), data.data() + whole, data.size() - whole);
+
+                for (std::size_t i = 0; i < data.size(); i += WORD, out += WORD + 1)
                 {
-                    if (current_set[i])
-                    flip ^= i;
+                    const char* word = i < whole ? data.data() + i : tail.data();
+                    std::memcpy(out, word, WORD);
+                    out[WORD] = static_cast<char>(Code::check_bytes(word));
                 }
+            }
 
-                if (type == Type::NORMAL)
+            //Corrects the data word of a codeword into out, returns false
+            //for a double error
+            template <unsigned DataBits>
+            bool decode_word(const char* codeword, char* out)
+            {
+                using Code = Secded<DataBits>;
+                constexpr std::size_t WORD = DataBits / 8;
+
+                std::memcpy(out, codeword, WORD);
+                const unsigned difference = Code::check_bytes(codeword)
+                    ^ static_cast<unsigned char>(codeword[WORD]);
+                if (!difference)
+                    return true;
+
+                const auto diagnosis = Code::diagnose(difference);
+                if (diagnosis.status == Code::Status::DOUBLE)
+                    return false;
+                if (diagnosis.bit < DataBits)
+                    out[diagnosis.bit / 8] ^= static_cast<char>(1 << (diagnosis.bit % 8));
+                return true;
+            }
+
+            //The input size comes first as a u64 LE, so the zero padding
+            //of the last word can be dropped. It is known once the input
+            //ends and written over a placeholder
+            template <unsigned DataBits>
+            void encode_words(std::istream& input, std::ostream& output, unsigned threads)
+            {
+                constexpr std::size_t WORD = DataBits / 8;
+                static_assert(DataBits % 8 == 0 && ENCODE_BLOCK % WORD == 0);
+
+                const auto start = output.tellp();
+                if (start == std::ostream::pos_type(-1))
+                    throw std::invalid_argument("Word aligned codes need a seekable output");
+
+                auto write_header = [&](std::uint64_t size)
+                {
+                    std::array<char, sizeof(std::uint64_t)> header;
+                    utils::store_u64_le(header.data(), size);
+                    std::array<char, words_size<DataBits>(sizeof(header))> encoded_header;
+                    encode_span<DataBits>(header, encoded_header.data());
+                    output.write(encoded_header.data(), encoded_header.size());
+                };
+
+                write_header(0);
+                const auto size = for_each_block<std::vector<char>>(input, ENCODE_BLOCK, threads,
+                    [](const Block& block, std::vector<char>& encoded)
+                    {
+                        encoded.resize(words_size<DataBits>(block.data.size()));
+                        encode_span<DataBits>(block.data, encoded.data());
+                    },
+                    [&](const std::vector<char>& encoded)
+                    {
+                        output.write(encoded.data(), encoded.size());
+                    });
+
+                if (size)
+                {
+                    output.seekp(start);
+                    write_header(size);
+                    output.seekp(0, std::ios::end);
+                }
+            }
+
+            template <unsigned DataBits>
+            void decode_words(std::istream& input, std::ostream& output, unsigned threads)
+            {
+                constexpr std::size_t WORD = DataBits / 8;
+                constexpr std::size_t STORED = WORD + 1;
+
+                std::array<char, sizeof(std::uint64_t)> header;
+                std::size_t header_read = 0;
+                std::uint64_t left = 0;
+
+                for_each_block<Decoded>(input, STORED * (ENCODE_BLOCK / WORD), threads,
+                    [](const Block& block, Decoded& result)
+                    {
+                        const std::size_t num_codewords = block.data.size() / STORED;
+                        result.data.resize(num_codewords * WORD);
+                        result.double_errors = 0;
+                        for (std::size_t c = 0; c < num_codewords; ++c)
+                        {
+                            if (!decode_word<DataBits>(block.data.data() + c * STORED,
+                                                       result.data.data() + c * WORD))
+                                ++result.double_errors;
+                        }
+                    },
+                    [&](const Decoded& decoded)
+                    {
+                        report(decoded.double_errors);
+                        std::span<const char> data = decoded.data;
+                        if (header_read < header.size())
+                        {
+                            const std::size_t n = std::min(data.size(), header.size() - header_read);
+                            std::memcpy(header.data() + header_read, data.data(), n);
+                            header_read += n;
+                            data = data.subspan(n);
+                            if (header_read == header.size())
+                                left = utils::load_u64_le(header.data());
+                        }
+
+                        const auto written = std::min<std::uint64_t>(data.size(), left);
+                        output.write(data.data(), written);
+                        left -= written;
+                    });
+            }
+
+            template <unsigned DataBits>
+            void check_words(std::istream& input, std::ostream& log_stream, unsigned threads)
+            {
+                using Code = Secded<DataBits>;
+                constexpr std::size_t WORD = DataBits / 8;
+                constexpr std::size_t STORED = WORD + 1;
+
+                for_each_block<std::string>(input, STORED * (ENCODE_BLOCK / WORD), threads,
+                    [](const Block& block, std::string& result)
+                    {
+                        std::ostringstream log;
+                        const std::size_t first = block.offset / STORED;
+                        const std::size_t num_codewords = block.data.size() / STORED;
+                        for (std::size_t c = 0; c < num_codewords; ++c)
+                        {
+                            const char* codeword = block.data.data() + c * STORED;
+                            const unsigned difference = Code::check_bytes(codeword)
+                                ^ static_cast<unsigned char>(codeword[WORD]);
+                            if (!difference)
+                                continue;
+
+                            const std::size_t cur_code_index = first + c;
+                            const auto diagnosis = Code::diagnose(difference);
+                            if (diagnosis.status == Code::Status::SINGLE)
+                            {
+                                log << "Single error at codeword " << cur_code_index + 1
+                                    << " bit " << diagnosis.bit << " ("
+                                    << cur_code_index * STORED * 8 + diagnosis.bit << ")\n";
+                            }
+                            else
+                            {
+                                log << "Double error at codeword " << cur_code_index + 1
+                                    << "\n";
+                            }
+                        }
+                        result = std::move(log).str();
+                    },
+                    [&](const std::string& log)
+                    {
+                        log_stream << log;
+                    });
+            }
+
+            //Writes the data bits of (15, 11) and (16, 11) codewords, returns
+            //the number of double errors
+            std::size_t decode_codewords(std::span<const char> codewords, Type type,
+                                         utils::BufferBitWriter& bit_writer)
+            {
+                const auto& table = decode_table(type);
+                std::size_t double_errors = 0;
+                auto decode_slow = [&](const char* data, std::size_t count)
                 {
-                    current_set.flip(flip);
+                    for (std::size_t c = 0; c < count; ++c)
+                    {
+                        const std::uint16_t entry = table[load_codeword(data + c * sizeof(std::uint16_t))];
+                        double_errors += (entry & DOUBLE_ERROR) != 0;
+                        bit_writer.write(entry & 0x7FF, 11);
+                    }
+                };
+
+                const std::size_t num_codewords = codewords.size() / sizeof(std::uint16_t);
+                std::size_t c = 0;
+                for (; c + screen::GROUP <= num_codewords; c += screen::GROUP)
+                {
+                    const char* group = codewords.data() + c * sizeof(std::uint16_t);
+                    if (!screen::clean(group))
+                    {
+                        decode_slow(group, screen::GROUP);
+                        continue;
+                    }
+
+                    //Nothing to correct, data bits are packed 4 words at once
+                    for (std::size_t k = 0; k < screen::GROUP; k += 4)
+                    {
+                        std::uint64_t bits = 0;
+                        for (std::size_t w = 0; w < 4; ++w)
+                        {
+                            bits |= std::uint64_t(extract_data(load_codeword(group + (k + w) * sizeof(std::uint16_t))))
+                                << (11 * w);
+                        }
+                        bit_writer.write(bits, 44);
+                    }
                 }
-                else if(type == Type::EXTENDED)
+                decode_slow(codewords.data() + c * sizeof(std::uint16_t), num_codewords - c);
+                return double_errors;
+            }
+
+            //Decodes the (15, 11) and (16, 11) codes. A block holds whole 8
+            //codeword groups, 11 bytes of output
+            void decode_packed(std::istream& input, std::ostream& output, Type type, unsigned threads)
+            {
+                for_each_block<Decoded>(input, DECODE_BLOCK, threads,
+                    [type](const Block& block, Decoded& result)
+                    {
+                        //11 bits of every 16 read, plus room for a flush
+                        result.data.resize(DECODE_BLOCK * 11 / 16 + 16);
+                        utils::BufferBitWriter bit_writer(result.data);
+                        result.double_errors = decode_codewords(block.data, type, bit_writer);
+
+                        //Last partial byte is padding and discarded
+                        bit_writer.flush();
+                        result.data.resize(bit_writer.size());
+                    },
+                    [&](const Decoded& decoded)
+                    {
+                        report(decoded.double_errors);
+                        output.write(decoded.data.data(), decoded.data.size());
+                    });
+            }
+
+            void check_packed(std::istream& input, std::ostream& log_stream, Type type, unsigned threads)
+            {
+                auto check_codewords = [type](const char* data, std::size_t count, std::size_t first,
+                                              std::ostream& log)
                 {
-                    if (current_set.count() % 2)
+                    for (std::size_t c = 0; c < count; ++c)
                     {
-                        //single error
-                        current_set.flip(flip);
+                        const std::uint16_t current = load_codeword(data + c * sizeof(current));
+                        const std::size_t flip = syndrome(current);
+                        if (!flip)
+                            continue;
+
+                        const std::size_t cur_code_index = first + c;
+                        if (type == Type::NORMAL
+                            || (type == Type::EXTENDED && std::popcount(current) % 2))
+                        {
+                            log << "Single error at codeword " << cur_code_index + 1
+                                << " bit " << flip << " (" << cur_code_index * 16 + flip
+                                << ")\n";
+                        }
+                        else if (type == Type::EXTENDED)
+                        {
+                            log << "Double error at codeword " << cur_code_index + 1
+                                << "\n";
+                        }
                     }
-                    else
+                };
+
+                //Codewords without a syndrome are never logged, clean groups
+                //are skipped
+                for_each_block<std::string>(input, DECODE_BLOCK, threads,
+                    [&check_codewords](const Block& block, std::string& result)
+                    {
+                        std::ostringstream log;
+                        const std::size_t first = block.offset / sizeof(std::uint16_t);
+                        const std::size_t num_codewords = block.data.size() / sizeof(std::uint16_t);
+                        for (std::size_t c = 0; c < num_codewords; c += screen::GROUP)
+                        {
+                            const char* group = block.data.data() + c * sizeof(std::uint16_t);
+                            const std::size_t count = std::min(screen::GROUP, num_codewords - c);
+                            if (count < screen::GROUP || !screen::clean(group))
+                                check_codewords(group, count, first + c, log);
+                        }
+                        result = std::move(log).str();
+                    },
+                    [&](const std::string& log)
                     {
-                        if (flip)
+                        log_stream << log;
+                    });
+            }
+
+            //Calls rewrite with the file offset and the corrected bytes of
+            //every codeword with a single error
+            template <typename Rewrite>
+            void repair_packed(std::span<const char> data, Type type, RepairResult& result,
+                               Rewrite rewrite)
+            {
+                auto repair_codewords = [&](std::size_t first, std::size_t count)
+                {
+                    for (std::size_t c = first; c < first + count; ++c)
+                    {
+                        std::uint16_t codeword = load_codeword(data.data() + c * sizeof(codeword));
+                        const unsigned flip = syndrome(codeword);
+                        const std::uint64_t offset = 1 + c * sizeof(codeword);
+                        if (type == Type::EXTENDED && std::popcount(codeword) % 2 == 0)
                         {
-                            //double
-                            std::cerr << "double error" << std::endl;
+                            if (flip)
+                                result.double_errors.push_back(offset);
+                            continue;
                         }
+                        if (type == Type::NORMAL && !flip)
+                            continue;
+
+                        codeword ^= static_cast<std::uint16_t>(1u << flip);
+                        std::array<char, sizeof(codeword)> bytes;
+                        std::memcpy(bytes.data(), &codeword, sizeof(codeword));
+                        rewrite(offset, bytes);
+                    }
+                };
+
+                const std::size_t num_codewords = data.size() / sizeof(std::uint16_t);
+                for (std::size_t c = 0; c < num_codewords; c += screen::GROUP)
+                {
+                    const char* group = data.data() + c * sizeof(std::uint16_t);
+                    const std::size_t count = std::min(screen::GROUP, num_codewords - c);
+                    const bool clean = count == screen::GROUP && (type == Type::EXTENDED
+                        ? screen::clean<screen::PARITY_MASKS>(group) : screen::clean(group));
+                    if (!clean)
+                        repair_codewords(c, count);
+                }
+            }
+
+            template <unsigned DataBits, typename Rewrite>
+            void repair_words(std::span<const char> data, RepairResult& result, Rewrite rewrite)
+            {
+                using Code = Secded<DataBits>;
+                constexpr std::size_t WORD = DataBits / 8;
+                constexpr std::size_t STORED = WORD + 1;
+
+                const std::size_t num_codewords = data.size() / STORED;
+                for (std::size_t c = 0; c < num_codewords; ++c)
+                {
+                    const char* codeword = data.data() + c * STORED;
+                    const unsigned difference = Code::check_bytes(codeword)
+                        ^ static_cast<unsigned char>(codeword[WORD]);
+                    if (!difference)
+                        continue;
+
+                    const std::uint64_t offset = 1 + c * STORED;
+                    const auto diagnosis = Code::diagnose(difference);
+                    if (diagnosis.status == Code::Status::DOUBLE)
+                    {
+                        result.double_errors.push_back(offset);
+                        continue;
                     }
+
+                    //Check bits are stored right after the data bits
+                    std::array<char, STORED> bytes;
+                    std::memcpy(bytes.data(), codeword, STORED);
+                    bytes[diagnosis.bit / 8] ^= static_cast<char>(1 << (diagnosis.bit % 8));
+                    rewrite(offset, bytes);
                 }
+            }
+        }
 
-                std::bitset<11> result;
-                result[0] = current_set[3];
-                result[1] = current_set[5];
-                result[2] = current_set[6];
-                result[3] = current_set[7];
-                result[4] = current_set[9];
-                result[5] = current_set[10];
-                result[6] = current_set[11];
-                result[7] = current_set[12];
-                result[8] = current_set[13];
-                result[9] = current_set[14];
-                result[10] = current_set[15];
-                bit_writer.write(result);
+        void encode(std::istream& input, std::ostream& output, Type type, unsigned threads)
+        {
+            if (type == Type::LEGACY)
+                throw std::invalid_argument("Legacy type can not be encoded");
+
+            output.put(char(type));
+            switch (type)
+            {
+            case Type::NORMAL:
+            case Type::EXTENDED:
+                encode_packed(input, output, type, threads);
+                break;
+            case Type::SECDED_39_32:
+                encode_words<32>(input, output, threads);
+                break;
+            case Type::SECDED_72_64:
+                encode_words<64>(input, output, threads);
+                break;
+            case Type::LEGACY:
+                break;
             }
         }
 
-        void check(const std::filesystem::path& input_file, std::ostream& log_stream)
+        void encode(const std::filesystem::path& from,
+                    const std::filesystem::path& to,
+                    Type type, unsigned threads)
+        {
+            std::ifstream input(from, std::ios::binary);
+            std::ofstream output(to, std::ios::binary);
+            encode(input, output, type, threads);
+        }
+
+        void encode(const std::filesystem::path& from,
+                    const std::filesystem::path& to)
+        {
+            encode(from, to, Type::EXTENDED);
+        }
+
+        void encode_not_extended(const std::filesystem::path& from,
+                                 const std::filesystem::path& to)
+        {
+            encode(from, to, Type::NORMAL);
+        }
+
+        namespace
+        {
+            constexpr std::size_t SIZE_HEADER = sizeof(std::uint64_t);
+
+            //Payload of a word aligned code is the size header and the words
+            template <unsigned DataBits>
+            std::size_t encode_words(std::span<const char> input, char* out)
+            {
+                std::array<char, SIZE_HEADER> header;
+                utils::store_u64_le(header.data(), input.size());
+                encode_span<DataBits>(header, out);
+                encode_span<DataBits>(input, out + words_size<DataBits>(SIZE_HEADER));
+                return words_size<DataBits>(SIZE_HEADER) + words_size<DataBits>(input.size());
+            }
+
+            //Reads the size header, the size is limited by the words present
+            template <unsigned DataBits>
+            std::size_t decoded_words_size(std::span<const char> payload, std::size_t& double_errors)
+            {
+                constexpr std::size_t WORD = DataBits / 8;
+                constexpr std::size_t STORED = WORD + 1;
+                if (payload.size() < words_size<DataBits>(SIZE_HEADER))
+                    throw std::invalid_argument("Unexpected end of header");
+
+                std::array<char, SIZE_HEADER> header;
+                for (std::size_t i = 0; i < SIZE_HEADER; i += WORD)
+                    double_errors += !decode_word<DataBits>(payload.data() + i / WORD * STORED, header.data() + i);
+
+                const std::size_t words = (payload.size() - words_size<DataBits>(SIZE_HEADER)) / STORED;
+                return std::min<std::uint64_t>(utils::load_u64_le(header.data()), words * WORD);
+            }
+
+            template <unsigned DataBits>
+            DecodeResult decode_words(std::span<const char> payload, std::span<char> output)
+            {
+                constexpr std::size_t WORD = DataBits / 8;
+                constexpr std::size_t STORED = WORD + 1;
+
+                DecodeResult result;
+                result.size = decoded_words_size<DataBits>(payload, result.double_errors);
+                if (output.size() < result.size)
+                    throw std::invalid_argument("Output buffer is too small");
+
+                const char* codeword = payload.data() + words_size<DataBits>(SIZE_HEADER);
+                const std::size_t whole = result.size / WORD;
+                for (std::size_t c = 0; c < whole; ++c, codeword += STORED)
+                    result.double_errors += !decode_word<DataBits>(codeword, output.data() + c * WORD);
+
+                //Padding of the last word is dropped
+                if (const std::size_t rest = result.size - whole * WORD)
+                {
+                    std::array<char, WORD> tail;
+                    result.double_errors += !decode_word<DataBits>(codeword, tail.data());
+                    std::memcpy(output.data() + whole * WORD, tail.data(), rest);
+                }
+                return result;
+            }
+
+            std::size_t packed_codewords(std::size_t size)
+            {
+                //One more codeword after the last whole one, as the stream encoder
+                return size ? size * 8 / 11 + 1 : 0;
+            }
+
+            Type read_type(std::span<const char> input)
+            {
+                if (input.empty() || static_cast<unsigned char>(input[0]) > static_cast<unsigned char>(Type::SECDED_72_64))
+                    throw std::invalid_argument("Unknown type");
+                return static_cast<Type>(input[0]);
+            }
+        }
+
+        std::size_t encoded_size(Type type, std::size_t size)
+        {
+            switch (type)
+            {
+            case Type::NORMAL:
+            case Type::EXTENDED:
+                return 1 + packed_codewords(size) * sizeof(std::uint16_t);
+            case Type::SECDED_39_32:
+                return 1 + words_size<32>(SIZE_HEADER) + words_size<32>(size);
+            case Type::SECDED_72_64:
+                return 1 + words_size<64>(SIZE_HEADER) + words_size<64>(size);
+            case Type::LEGACY:
+                throw std::invalid_argument("Legacy type can not be encoded");
+            }
+            throw std::invalid_argument("Unknown type");
+        }
+
+        std::size_t encode(std::span<const std::byte> input, std::span<std::byte> output, Type type)
+        {
+            if (output.size() < encoded_size(type, input.size()))
+                throw std::invalid_argument("Output buffer is too small");
+
+            const auto in = utils::as_chars(input);
+            char* out = utils::as_writable_chars(output).data();
+            out[0] = static_cast<char>(type);
+            switch (type)
+            {
+            case Type::NORMAL:
+            case Type::EXTENDED:
+                encode_block(in, packed_codewords(in.size()), type, out + 1);
+                return 1 + packed_codewords(in.size()) * sizeof(std::uint16_t);
+            case Type::SECDED_39_32:
+                return 1 + encode_words<32>(in, out + 1);
+            case Type::SECDED_72_64:
+                return 1 + encode_words<64>(in, out + 1);
+            case Type::LEGACY:
+                break;
+            }
+            throw std::invalid_argument("Unknown type");
+        }
+
+        std::size_t decoded_size(std::span<const std::byte> input)
+        {
+            const auto in = utils::as_chars(input);
+            std::size_t double_errors = 0;
+            switch (read_type(in))
+            {
+            case Type::SECDED_39_32:
+                return decoded_words_size<32>(in.subspan(1), double_errors);
+            case Type::SECDED_72_64:
+                return decoded_words_size<64>(in.subspan(1), double_errors);
+            default:
+                //Last partial byte is padding
+                return (in.size() - 1) / sizeof(std::uint16_t) * 11 / 8;
+            }
+        }
+
+        DecodeResult decode(std::span<const std::byte> input, std::span<std::byte> output)
+        {
+            const auto in = utils::as_chars(input);
+            const auto out = utils::as_writable_chars(output);
+            const Type type = read_type(in);
+            if (type == Type::SECDED_39_32)
+                return decode_words<32>(in.subspan(1), out);
+            if (type == Type::SECDED_72_64)
+                return decode_words<64>(in.subspan(1), out);
+
+            DecodeResult result;
+            result.size = decoded_size(input);
+            if (out.size() < result.size)
+                throw std::invalid_argument("Output buffer is too small");
+
+            const std::size_t num_codewords = (in.size() - 1) / sizeof(std::uint16_t);
+            utils::BufferBitWriter bit_writer(out.first(result.size));
+            result.double_errors = decode_codewords(in.subspan(1, num_codewords * sizeof(std::uint16_t)),
+                                                    type, bit_writer);
+            bit_writer.flush();
+            return result;
+        }
+
+        void decode(const std::filesystem::path& from,
+                    const std::filesystem::path& to,
+                    unsigned threads)
+        {
+            std::ifstream input(from, std::ios::binary);
+            std::ofstream output(to, std::ios::binary);
+            decode(input, output, threads);
+        }
+
+        void decode(std::istream& input, std::ostream& output, unsigned threads)
+        {
+            unsigned char type_char = input.get();
+            if (type_char > static_cast<unsigned char>(Type::SECDED_72_64))
+            {
+                std::cerr << "Unknown type" << std::endl;
+                throw std::exception();
+            }
+
+            Type type = static_cast<Type>(type_char);
+            if (type == Type::SECDED_39_32)
+                decode_words<32>(input, output, threads);
+            else if (type == Type::SECDED_72_64)
+                decode_words<64>(input, output, threads);
+            else
+                decode_packed(input, output, type, threads);
+        }
+
+        void check(const std::filesystem::path& input_file, std::ostream& log_stream,
+                   unsigned threads)
         {
             std::ifstream input(input_file, std::ios::binary);
 
             unsigned char type_char = input.get();
-            if (type_char > 2)
+            if (type_char > static_cast<unsigned char>(Type::SECDED_72_64))
             {
                 log_stream << "Wrong header\n";
                 return;
@@ -180,56 +866,65 @@ namespace tik
             {
                 log_stream << "Hamming(15, 11)\n";
             }
+            else if (type == Type::SECDED_39_32)
+            {
+                log_stream << "Hamming(39, 32)\n";
+                return check_words<32>(input, log_stream, threads);
+            }
+            else if (type == Type::SECDED_72_64)
+            {
+                log_stream << "Hamming(72, 64)\n";
+                return check_words<64>(input, log_stream, threads);
+            }
+            else if (type == Type::LEGACY)
+            {
+                log_stream << "Hamming(16, 11) without correction\n";
+            }
             else
             {
                 log_stream << "Hamming(16, 11)\n";
             }
 
-            uint16_t current;
-            std::size_t cur_code_index = 0;
-            while(input.read(reinterpret_cast<char*>(&current), sizeof(current)))
-            {
-                std::bitset<sizeof(current) * 8> current_set = current;
+            check_packed(input, log_stream, type, threads);
+        }
 
-                std::size_t flip = 0;
-                for (std::size_t i = 0; i < current_set.size(); ++i)
-                {
-                    if (current_set[i])
-                    flip ^= i;
-                }
+        RepairResult repair(const std::filesystem::path& file)
+        {
+            const utils::MappedFile mapped(file);
+            const auto data = mapped.data();
+            if (data.empty() || static_cast<unsigned char>(data[0]) > static_cast<unsigned char>(Type::SECDED_72_64))
+                throw std::invalid_argument("Unknown type");
 
-                if (type == Type::NORMAL)
-                {
-                    if (flip)
-                    {
-                        log_stream << "Single error at codeword " << cur_code_index + 1
-                                   << " bit " << flip << " (" << cur_code_index * 16 + flip
-                                   << ")\n";
-                    }
-                }
-                else if(type == Type::EXTENDED)
-                {
-                    if (current_set.count() % 2)
-                    {
-                        //single error
-                        if (flip)
-                        {
-                            log_stream << "Single error at codeword " << cur_code_index + 1
-                                       << " bit " << flip << " (" << cur_code_index * 16 + flip
-                                       << ")\n";
-                        }
-                    }
-                    else
-                    {
-                        if (flip)
-                        {
-                            log_stream << "Double error at codeword " << cur_code_index + 1
-                                       << "\n";
-                        }
-                    }
-                }
-                cur_code_index++;
+            RepairResult result;
+            std::fstream output(file, std::ios::in | std::ios::out | std::ios::binary);
+            auto rewrite = [&](std::uint64_t offset, std::span<const char> codeword)
+            {
+                output.seekp(offset);
+                output.write(codeword.data(), codeword.size());
+                ++result.repaired;
+            };
+
+            const Type type = static_cast<Type>(data[0]);
+            switch (type)
+            {
+            case Type::NORMAL:
+            case Type::EXTENDED:
+                repair_packed(data.subspan(1), type, result, rewrite);
+                break;
+            case Type::SECDED_39_32:
+                repair_words<32>(data.subspan(1), result, rewrite);
+                break;
+            case Type::SECDED_72_64:
+                repair_words<64>(data.subspan(1), result, rewrite);
+                break;
+            case Type::LEGACY:
+                //Decoded without correction, so nothing is repaired
+                break;
             }
+
+            if (!output)
+                throw std::runtime_error("Failed to write " + file.string());
+            return result;
         }
     }
 }
@@ -1,20 +1,85 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <iostream>
+#include <span>
+#include <vector>
 
 namespace tik
 {
     namespace hamming
     {
+        //Code of an encoded file, kept in its first byte
+        enum class Type
+        {
+            //Hamming(15, 11)
+            NORMAL,
+            //Hamming(16, 11)
+            EXTENDED,
+            //Accepted by the first decoder though nothing writes it. Its
+            //(16, 11) codewords are read without correction or error
+            //reports, encoding it throws std::invalid_argument
+            LEGACY,
+            //Word aligned SECDED codes
+            SECDED_39_32 = 3,
+            SECDED_72_64 = 4
+        };
+
         void encode(const std::filesystem::path& from,
                     const std::filesystem::path& to);
 
+        //Blocks of the file are coded on threads and written in order
+        void encode(const std::filesystem::path& from,
+                    const std::filesystem::path& to,
+                    Type type, unsigned threads = 1);
+
         void encode_not_extended(const std::filesystem::path& from,
                                  const std::filesystem::path& to);
 
         void decode(const std::filesystem::path& from,
-                    const std::filesystem::path& to);
+                    const std::filesystem::path& to,
+                    unsigned threads = 1);
+
+        //Streaming variants. Word aligned codes store the input size in
+        //front, so their output has to be seekable
+        void encode(std::istream& input, std::ostream& output, Type type, unsigned threads = 1);
+        void decode(std::istream& input, std::ostream& output, unsigned threads = 1);
+
+        //In memory variants with the bytes of the file format. They do not
+        //allocate, so buffers kept by the caller code any number of inputs
+        //without touching the heap
+        std::size_t encoded_size(Type type, std::size_t size);
+        //Returns the bytes written. Throws std::invalid_argument when output
+        //is smaller than encoded_size
+        std::size_t encode(std::span<const std::byte> input, std::span<std::byte> output, Type type);
+
+        struct DecodeResult
+        {
+            std::size_t size = 0;
+            std::size_t double_errors = 0;
+        };
+
+        //Throws std::invalid_argument for unknown types and truncated input
+        std::size_t decoded_size(std::span<const std::byte> input);
+        //Single errors are corrected, double errors are counted
+        DecodeResult decode(std::span<const std::byte> input, std::span<std::byte> output);
+
+        struct RepairResult
+        {
+            //Codewords with a corrected single error
+            std::size_t repaired = 0;
+            //File offsets of codewords with errors that can not be corrected
+            std::vector<std::uint64_t> double_errors;
+        };
+
+        //Corrects single errors of an encoded file in place. The file is
+        //scanned through a read only mapping and only damaged codewords
+        //are written back. Throws std::invalid_argument for unknown types
+        RepairResult repair(const std::filesystem::path& file);
 
+        //The log lists codewords in file order for any number of threads
         void check(const std::filesystem::path& input_file,
-                   std::ostream& log_stream);
+                   std::ostream& log_stream, unsigned threads = 1);
     }
 }
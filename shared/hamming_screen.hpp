@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TIK_HAMMING_AVX2 1
+#include <immintrin.h>
+#else
+#define TIK_HAMMING_AVX2 0
+#endif
+
+namespace tik
+{
+    namespace hamming
+    {
+        //Finds groups of 16 bit codewords whose syndromes are all zero.
+        //Syndrome bit j is the parity of the codeword bits whose index has
+        //bit j set, parities of many codewords are folded in parallel
+        namespace screen
+        {
+            inline constexpr std::array<std::uint16_t, 4> SYNDROME_MASKS = {0xAAAA, 0xCCCC, 0xF0F0, 0xFF00};
+            //Also rejects (16, 11) codewords with odd parity, the flip of
+            //bit 0 leaves the syndrome zero
+            inline constexpr std::array<std::uint16_t, 5> PARITY_MASKS = {0xAAAA, 0xCCCC, 0xF0F0, 0xFF00, 0xFFFF};
+
+            //Codewords checked by one call
+            constexpr std::size_t GROUP = 64;
+
+            //Parity of every 16 bit lane ends up in the lowest bit of the
+            //lane, bits carried in from the next lane never reach it
+            template <const auto& masks = SYNDROME_MASKS>
+            inline bool clean_scalar(const char* data)
+            {
+                constexpr std::uint64_t LANES = 0x0001000100010001;
+                std::uint64_t any = 0;
+                for (std::size_t i = 0; i < GROUP * sizeof(std::uint16_t); i += sizeof(std::uint64_t))
+                {
+                    std::uint64_t word;
+                    std::memcpy(&word, data + i, sizeof(word));
+                    for (const auto mask : masks)
+                    {
+                        std::uint64_t x = word & (mask * LANES);
+                        x ^= x >> 8;
+                        x ^= x >> 4;
+                        x ^= x >> 2;
+                        x ^= x >> 1;
+                        any |= x;
+                    }
+                }
+                return !(any & LANES);
+            }
+
+#if TIK_HAMMING_AVX2
+            template <const auto& masks = SYNDROME_MASKS>
+            __attribute__((target("avx2")))
+            inline bool clean_avx2(const char* data)
+            {
+                __m256i any = _mm256_setzero_si256();
+                for (std::size_t i = 0; i < GROUP * sizeof(std::uint16_t); i += sizeof(__m256i))
+                {
+                    const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                    for (const auto mask : masks)
+                    {
+                        __m256i x = _mm256_and_si256(words, _mm256_set1_epi16(static_cast<short>(mask)));
+                        x = _mm256_xor_si256(x, _mm256_srli_epi16(x, 8));
+                        x = _mm256_xor_si256(x, _mm256_srli_epi16(x, 4));
+                        x = _mm256_xor_si256(x, _mm256_srli_epi16(x, 2));
+                        x = _mm256_xor_si256(x, _mm256_srli_epi16(x, 1));
+                        any = _mm256_or_si256(any, x);
+                    }
+                }
+                return _mm256_testz_si256(any, _mm256_set1_epi16(1));
+            }
+#endif
+
+            //True when every codeword of the GROUP at data has even parity
+            //over every mask, a zero syndrome by default
+            template <const auto& masks = SYNDROME_MASKS>
+            inline bool clean(const char* data)
+            {
+#if TIK_HAMMING_AVX2
+                static const bool avx2 = __builtin_cpu_supports("avx2");
+                if (avx2)
+                    return clean_avx2<masks>(data);
+#endif
+                return clean_scalar<masks>(data);
+            }
+        }
+    }
+}
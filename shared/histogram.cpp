@@ -0,0 +1,80 @@
+#include "histogram.hpp"
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <vector>
+#include "thread_pool.hpp"
+
+namespace tik
+{
+    namespace utils
+    {
+        namespace
+        {
+            //32 bit counters of a block can not overflow
+            constexpr std::size_t BLOCK_SIZE = std::size_t(1) << 30;
+            constexpr std::size_t MIN_THREAD_SIZE = std::size_t(1) << 20;
+
+            void count_block(std::span<const unsigned char> data, Histogram& result)
+            {
+                std::array<std::array<std::uint32_t, 256>, 4> tables{};
+
+                std::size_t i = 0;
+                for (; i + 8 <= data.size(); i += 8)
+                {
+                    std::uint64_t word;
+                    std::memcpy(&word, data.data() + i, sizeof(word));
+                    ++tables[0][word & 0xFF];
+                    ++tables[1][(word >> 8) & 0xFF];
+                    ++tables[2][(word >> 16) & 0xFF];
+                    ++tables[3][(word >> 24) & 0xFF];
+                    ++tables[0][(word >> 32) & 0xFF];
+                    ++tables[1][(word >> 40) & 0xFF];
+                    ++tables[2][(word >> 48) & 0xFF];
+                    ++tables[3][word >> 56];
+                }
+                for (; i < data.size(); ++i)
+                    ++tables[0][data[i]];
+
+                for (std::size_t c = 0; c < result.size(); ++c)
+                    result[c] += std::uint64_t(tables[0][c]) + tables[1][c] + tables[2][c] + tables[3][c];
+            }
+        }
+
+        Histogram histogram(std::span<const char> data)
+        {
+            const std::span<const unsigned char> bytes(
+                reinterpret_cast<const unsigned char*>(data.data()), data.size());
+
+            Histogram result{};
+            for (std::size_t offset = 0; offset < bytes.size(); offset += BLOCK_SIZE)
+                count_block(bytes.subspan(offset, std::min(BLOCK_SIZE, bytes.size() - offset)), result);
+            return result;
+        }
+
+        Histogram histogram(std::span<const char> data, unsigned threads)
+        {
+            threads = std::clamp<std::size_t>(data.size() / MIN_THREAD_SIZE, 1, std::max(threads, 1u));
+            if (threads == 1)
+                return histogram(data);
+
+            const std::size_t part = (data.size() + threads - 1) / threads;
+            ThreadPool pool(threads);
+            std::vector<std::future<Histogram>> partial;
+            for (std::size_t offset = 0; offset < data.size(); offset += part)
+            {
+                const auto span = data.subspan(offset, std::min(part, data.size() - offset));
+                partial.push_back(pool.submit([span]() { return histogram(span); }));
+            }
+
+            Histogram result{};
+            for (auto& future : partial)
+            {
+                const auto counts = future.get();
+                for (std::size_t c = 0; c < result.size(); ++c)
+                    result[c] += counts[c];
+            }
+            return result;
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace tik
+{
+    namespace utils
+    {
+        using Histogram = std::array<std::uint64_t, 256>;
+
+        //Counts with several interleaved tables so consecutive equal
+        //bytes do not wait on each other's increments
+        Histogram histogram(std::span<const char> data);
+
+        //Splits data between threads and merges partial counts
+        Histogram histogram(std::span<const char> data, unsigned threads);
+    }
+}
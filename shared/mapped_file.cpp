@@ -0,0 +1,49 @@
+#include "mapped_file.hpp"
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tik
+{
+    namespace utils
+    {
+        MappedFile::MappedFile(const std::filesystem::path& path)
+        {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), path.string());
+
+            struct stat info;
+            if (::fstat(fd, &info) < 0)
+            {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), path.string());
+            }
+
+            m_size = info.st_size;
+            if (m_size)
+            {
+                m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (m_data == MAP_FAILED)
+                {
+                    const int error = errno;
+                    ::close(fd);
+                    m_data = nullptr;
+                    throw std::system_error(error, std::generic_category(), path.string());
+                }
+                ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+            }
+            ::close(fd);
+        }
+
+        MappedFile::~MappedFile()
+        {
+            if (m_data)
+                ::munmap(m_data, m_size);
+        }
+    }
+}
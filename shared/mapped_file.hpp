@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace tik
+{
+    namespace utils
+    {
+        //Read only memory mapping of a whole file
+        class MappedFile
+        {
+        public:
+            explicit MappedFile(const std::filesystem::path& path);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            std::span<const char> data() const
+            {
+                return {static_cast<const char*>(m_data), m_size};
+            }
+
+            std::size_t size() const { return m_size; }
+
+        private:
+            void* m_data = nullptr;
+            std::size_t m_size = 0;
+        };
+    }
+}
@@ -0,0 +1,131 @@
+#include "pipeline.hpp"
+#include <fstream>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include "spsc_ring.hpp"
+#include "thread_pool.hpp"
+
+namespace tik
+{
+    namespace pipeline
+    {
+        void run(std::istream& input, std::ostream& output,
+                 const std::vector<Stage>& stages, std::size_t ring_size)
+        {
+            //Ring i connects stage i to stage i + 1
+            std::vector<std::unique_ptr<utils::SpscRing>> rings;
+            for (std::size_t i = 1; i < stages.size(); ++i)
+                rings.push_back(std::make_unique<utils::SpscRing>(ring_size));
+
+            std::vector<std::future<void>> results;
+            utils::ThreadPool pool(stages.size());
+            for (std::size_t i = 0; i < stages.size(); ++i)
+            {
+                results.push_back(pool.submit([&, i]()
+                {
+                    std::optional<utils::RingReadBuffer> read_buffer;
+                    std::optional<utils::RingWriteBuffer> write_buffer;
+                    std::istream ring_input(nullptr);
+                    std::ostream ring_output(nullptr);
+                    if (i > 0)
+                        ring_input.rdbuf(&read_buffer.emplace(*rings[i - 1]));
+                    if (i + 1 < stages.size())
+                        ring_output.rdbuf(&write_buffer.emplace(*rings[i]));
+
+                    //Whatever happens the next stage sees the end of its
+                    //input and the previous one stops blocking on a full ring
+                    try
+                    {
+                        stages[i](i > 0 ? ring_input : input, write_buffer ? ring_output : output);
+                    }
+                    catch (...)
+                    {
+                        if (write_buffer)
+                            write_buffer->close();
+                        if (i > 0)
+                            rings[i - 1]->abandon();
+                        throw;
+                    }
+                    if (write_buffer)
+                        write_buffer->close();
+                    if (i > 0)
+                        rings[i - 1]->abandon();
+                }));
+            }
+
+            for (auto& result : results)
+                result.wait();
+            for (auto& result : results)
+                result.get();
+        }
+
+        std::uint64_t protect(const std::filesystem::path& from,
+                              const std::filesystem::path& to,
+                              const Options& options)
+        {
+            if (options.hamming == hamming::Type::NORMAL || options.hamming == hamming::Type::EXTENDED)
+                throw std::invalid_argument("Pipelines need a word aligned hamming code");
+
+            std::ifstream input(from, std::ios::binary);
+            std::ofstream output(to, std::ios::binary);
+            std::uint64_t crc = 0;
+            run(input, output, {
+                [&](std::istream& in, std::ostream& out)
+                {
+                    switch (options.compression)
+                    {
+                    case Compression::HUFFMAN:
+                        encode_huffman(in, out, options.encode);
+                        break;
+                    case Compression::SHANNON_FANO:
+                        encode_shannon_fano(in, out, options.encode);
+                        break;
+                    case Compression::FSE:
+                        encode_fse(in, out, options.encode);
+                        break;
+                    }
+                },
+                [&](std::istream& in, std::ostream& out)
+                {
+                    crc = crc::encode(in, out, options.crc);
+                },
+                [&](std::istream& in, std::ostream& out)
+                {
+                    hamming::encode(in, out, options.hamming, options.hamming_threads);
+                }}, options.ring_size);
+
+            if (!output)
+                throw std::runtime_error("Failed to write " + to.string());
+            return crc;
+        }
+
+        crc::DecodeResult restore(const std::filesystem::path& from,
+                                  const std::filesystem::path& to,
+                                  std::ostream& log,
+                                  const RestoreOptions& options)
+        {
+            std::ifstream input(from, std::ios::binary);
+            std::ofstream output(to, std::ios::binary);
+            crc::DecodeResult result{0, 0, 0};
+            run(input, output, {
+                [&](std::istream& in, std::ostream& out)
+                {
+                    hamming::decode(in, out, options.hamming_threads);
+                },
+                [&](std::istream& in, std::ostream& out)
+                {
+                    result = crc::decode(in, out, log, options.crc);
+                },
+                [&](std::istream& in, std::ostream& out)
+                {
+                    decode(in, out, options.decode_threads);
+                }}, options.ring_size);
+
+            if (!output)
+                throw std::runtime_error("Failed to write " + to.string());
+            return result;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include "crc.hpp"
+#include "hamming.hpp"
+#include "tik.hpp"
+
+namespace tik
+{
+    //Chains compression, crc blocks and hamming codes without files in
+    //between. Every stage runs on its own thread and hands its output to
+    //the next one through a utils::SpscRing, so a file is read once and
+    //its protected form written once
+    namespace pipeline
+    {
+        enum class Compression
+        {
+            HUFFMAN,
+            SHANNON_FANO,
+            FSE
+        };
+
+        struct Options
+        {
+            Compression compression = Compression::HUFFMAN;
+            //Streaming windows of the compressor
+            EncodeOptions encode;
+            crc::Options crc;
+            //Only word aligned codes decode to the exact stream length
+            hamming::Type hamming = hamming::Type::SECDED_72_64;
+            unsigned hamming_threads = 1;
+            //Bytes queued between two stages
+            std::size_t ring_size = 1 << 22;
+        };
+
+        struct RestoreOptions
+        {
+            crc::DecodeOptions crc;
+            unsigned hamming_threads = 1;
+            unsigned decode_threads = 1;
+            std::size_t ring_size = 1 << 22;
+        };
+
+        //Reads its input stream to the end and writes its output stream
+        using Stage = std::function<void(std::istream&, std::ostream&)>;
+
+        //Runs stages concurrently, the first one reads input and the last
+        //one writes output. A failed stage closes its rings so the others
+        //run to the end, then the exception of the earliest failed stage
+        //is rethrown
+        void run(std::istream& input, std::ostream& output,
+                 const std::vector<Stage>& stages, std::size_t ring_size);
+
+        //Compresses, splits into crc blocks and hamming encodes, returns
+        //the crc of the compressed stream. Throws std::invalid_argument
+        //for hamming codes that are not word aligned
+        std::uint64_t protect(const std::filesystem::path& from,
+                              const std::filesystem::path& to,
+                              const Options& options = {});
+
+        //Hamming decodes, checks and strips crc blocks and decompresses.
+        //Blocks that fail the check are reported to log
+        crc::DecodeResult restore(const std::filesystem::path& from,
+                                  const std::filesystem::path& to,
+                                  std::ostream& log,
+                                  const RestoreOptions& options = {});
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+namespace tik
+{
+    namespace hamming
+    {
+        //Extended Hamming code over DataBits data bits, corrects one and
+        //detects two flipped bits. Data bit i takes the i-th position of
+        //1 .. 2^r - 1 that is not a power of two, parity bit j covers the
+        //positions with bit j set and the overall parity makes the whole
+        //codeword even
+        template <unsigned DataBits>
+        struct Secded
+        {
+            static constexpr unsigned PARITY_BITS = []()
+            {
+                unsigned r = 1;
+                while ((1u << r) < DataBits + r + 1)
+                    ++r;
+                return r;
+            }();
+            //Parity bits followed by the overall parity
+            static constexpr unsigned CHECK_BITS = PARITY_BITS + 1;
+            static constexpr unsigned CODE_BITS = DataBits + CHECK_BITS;
+            static_assert(DataBits <= 64 && CHECK_BITS <= 8);
+
+            using Data = std::conditional_t<DataBits <= 16, std::uint16_t,
+                         std::conditional_t<DataBits <= 32, std::uint32_t, std::uint64_t>>;
+
+            static constexpr std::array<unsigned, DataBits> POSITIONS = []()
+            {
+                std::array<unsigned, DataBits> result{};
+                unsigned position = 1;
+                for (auto& p : result)
+                {
+                    while (std::has_single_bit(position))
+                        ++position;
+                    p = position++;
+                }
+                return result;
+            }();
+
+            //Data bit at every position, DataBits where there is none
+            static constexpr std::array<unsigned, 1u << PARITY_BITS> DATA_INDEX = []()
+            {
+                std::array<unsigned, 1u << PARITY_BITS> result{};
+                result.fill(DataBits);
+                for (unsigned i = 0; i < DataBits; ++i)
+                    result[POSITIONS[i]] = i;
+                return result;
+            }();
+
+            static constexpr unsigned check(Data data)
+            {
+                unsigned result = 0;
+                for (unsigned i = 0; i < DataBits; ++i)
+                {
+                    if ((data >> i) & 1)
+                        result ^= POSITIONS[i];
+                }
+                const unsigned overall = (std::popcount(data) + std::popcount(result)) & 1;
+                return result | overall << PARITY_BITS;
+            }
+
+            //Codeword in position order, bit 0 holds the overall parity
+            static constexpr std::uint64_t pack(Data data) requires (CODE_BITS <= 64)
+            {
+                const unsigned bits = check(data);
+                std::uint64_t result = (bits >> PARITY_BITS) & 1;
+                for (unsigned j = 0; j < PARITY_BITS; ++j)
+                    result |= std::uint64_t((bits >> j) & 1) << (1u << j);
+                for (unsigned i = 0; i < DataBits; ++i)
+                    result |= std::uint64_t((data >> i) & 1) << POSITIONS[i];
+                return result;
+            }
+
+            //Check bits are linear in the data, so they are the xor of the
+            //check bits of every data byte
+            static constexpr auto BYTE_CHECKS = []()
+            {
+                std::array<std::array<std::uint8_t, 256>, (DataBits + 7) / 8> result{};
+                for (unsigned k = 0; k < result.size(); ++k)
+                {
+                    for (unsigned b = 0; b < 256; ++b)
+                    {
+                        const std::uint64_t shifted = std::uint64_t(b) << (8 * k);
+                        const std::uint64_t mask = DataBits == 64 ? ~std::uint64_t(0)
+                            : (std::uint64_t(1) << DataBits) - 1;
+                        result[k][b] = static_cast<std::uint8_t>(check(static_cast<Data>(shifted & mask)));
+                    }
+                }
+                return result;
+            }();
+
+            //Check bits of data stored as little endian bytes
+            static unsigned check_bytes(const char* data)
+            {
+                unsigned result = 0;
+                for (unsigned k = 0; k < BYTE_CHECKS.size(); ++k)
+                    result ^= BYTE_CHECKS[k][static_cast<unsigned char>(data[k])];
+                return result;
+            }
+
+            enum class Status
+            {
+                CLEAN,
+                SINGLE,
+                DOUBLE
+            };
+
+            struct Diagnosis
+            {
+                Status status;
+                //Flipped bit of a single error: data bits first, then the
+                //parity bits and the overall parity
+                unsigned bit;
+            };
+
+            //Reads the difference of stored and recomputed check bits
+            static constexpr Diagnosis diagnose(unsigned difference)
+            {
+                if (!difference)
+                    return {Status::CLEAN, 0};
+
+                const unsigned syndrome = difference & ((1u << PARITY_BITS) - 1);
+                const bool odd = ((difference >> PARITY_BITS) ^ std::popcount(syndrome)) & 1;
+                if (!odd)
+                    return {Status::DOUBLE, 0};
+                if (!syndrome)
+                    return {Status::SINGLE, DataBits + PARITY_BITS};
+                if (std::has_single_bit(syndrome))
+                    return {Status::SINGLE, DataBits + static_cast<unsigned>(std::countr_zero(syndrome))};
+
+                //Positions past the code are only reached by more flips
+                const unsigned index = DATA_INDEX[syndrome];
+                if (index == DataBits)
+                    return {Status::DOUBLE, 0};
+                return {Status::SINGLE, index};
+            }
+        };
+    }
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <streambuf>
+#include <vector>
+
+namespace tik
+{
+    namespace utils
+    {
+        //Bounded byte queue between one writer and one reader thread. The
+        //writer only stores the head and the reader only stores the tail,
+        //both grow without wrapping, so no locks are taken. A side waits
+        //on the position of the other one when the ring is full or empty
+        class SpscRing
+        {
+        public:
+            //Capacity is rounded up to a power of two
+            explicit SpscRing(std::size_t capacity)
+                : m_buffer(std::bit_ceil(std::max<std::size_t>(capacity, 2))),
+                  m_mask(m_buffer.size() - 1)
+            {}
+
+            SpscRing(const SpscRing&) = delete;
+            SpscRing& operator=(const SpscRing&) = delete;
+
+            //Blocks until all of data is queued, false when the reader has
+            //abandoned the ring
+            bool write(std::span<const char> data)
+            {
+                std::uint64_t head = m_head.load(std::memory_order_relaxed);
+                while (!data.empty())
+                {
+                    const std::uint64_t tail = m_tail.load(std::memory_order_acquire);
+                    if (tail & FLAG)
+                        return false;
+
+                    const std::size_t free = m_buffer.size() - (head - tail);
+                    if (!free)
+                    {
+                        m_tail.wait(tail, std::memory_order_acquire);
+                        continue;
+                    }
+
+                    const std::size_t n = std::min(free, data.size());
+                    copy_in(head, data.first(n));
+                    data = data.subspan(n);
+                    head += n;
+                    m_head.store(head, std::memory_order_release);
+                    m_head.notify_one();
+                }
+                return true;
+            }
+
+            //Blocks until some bytes are queued, returns the number of bytes
+            //read, 0 once the writer has closed the ring and it is empty
+            std::size_t read(std::span<char> data)
+            {
+                const std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    const std::uint64_t head = m_head.load(std::memory_order_acquire);
+                    const std::uint64_t available = (head & ~FLAG) - tail;
+                    if (!available && (head & FLAG))
+                        return 0;
+                    if (!available)
+                    {
+                        m_head.wait(head, std::memory_order_acquire);
+                        continue;
+                    }
+
+                    const std::size_t n = std::min<std::uint64_t>(available, data.size());
+                    copy_out(tail, data.first(n));
+                    m_tail.store(tail + n, std::memory_order_release);
+                    m_tail.notify_one();
+                    return n;
+                }
+            }
+
+            //Called by the writer after the last write
+            void close()
+            {
+                m_head.fetch_or(FLAG, std::memory_order_release);
+                m_head.notify_one();
+            }
+
+            //Called by the reader when it stops early, later writes fail
+            void abandon()
+            {
+                m_tail.fetch_or(FLAG, std::memory_order_release);
+                m_tail.notify_one();
+            }
+
+        private:
+            //Marks a closed head or an abandoned tail
+            static constexpr std::uint64_t FLAG = std::uint64_t(1) << 63;
+
+            void copy_in(std::uint64_t position, std::span<const char> data)
+            {
+                const std::size_t start = position & m_mask;
+                const std::size_t first = std::min(data.size(), m_buffer.size() - start);
+                std::memcpy(m_buffer.data() + start, data.data(), first);
+                std::memcpy(m_buffer.data(), data.data() + first, data.size() - first);
+            }
+
+            void copy_out(std::uint64_t position, std::span<char> data) const
+            {
+                const std::size_t start = position & m_mask;
+                const std::size_t first = std::min(data.size(), m_buffer.size() - start);
+                std::memcpy(data.data(), m_buffer.data() + start, first);
+                std::memcpy(data.data() + first, m_buffer.data(), data.size() - first);
+            }
+
+            std::vector<char> m_buffer;
+            std::size_t m_mask;
+            //Positions are on separate cache lines, each is stored by one side
+            alignas(64) std::atomic<std::uint64_t> m_head{0};
+            alignas(64) std::atomic<std::uint64_t> m_tail{0};
+        };
+
+        //Output stream buffer that queues whole buffers into a ring. Writes
+        //fail once the reader has abandoned the ring
+        class RingWriteBuffer : public std::streambuf
+        {
+        public:
+            explicit RingWriteBuffer(SpscRing& ring, std::size_t buffer_size = 1 << 16)
+                : m_ring(ring), m_buffer(buffer_size)
+            {
+                setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+            }
+
+            //Flushes and marks the end of the stream for the reader
+            void close()
+            {
+                sync();
+                m_ring.close();
+            }
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if (sync() != 0)
+                    return traits_type::eof();
+                if (!traits_type::eq_int_type(c, traits_type::eof()))
+                {
+                    *pptr() = traits_type::to_char_type(c);
+                    pbump(1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            int sync() override
+            {
+                const bool written = m_ring.write(std::span<const char>(pbase(), pptr()));
+                setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+                return written ? 0 : -1;
+            }
+
+        private:
+            SpscRing& m_ring;
+            std::vector<char> m_buffer;
+        };
+
+        //Input stream buffer that takes whatever the ring holds on underflow
+        class RingReadBuffer : public std::streambuf
+        {
+        public:
+            explicit RingReadBuffer(SpscRing& ring, std::size_t buffer_size = 1 << 16)
+                : m_ring(ring), m_buffer(buffer_size)
+            {
+                setg(m_buffer.data(), m_buffer.data(), m_buffer.data());
+            }
+
+        protected:
+            int_type underflow() override
+            {
+                const std::size_t n = m_ring.read(m_buffer);
+                setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + n);
+                return n ? traits_type::to_int_type(m_buffer[0]) : traits_type::eof();
+            }
+
+        private:
+            SpscRing& m_ring;
+            std::vector<char> m_buffer;
+        };
+    }
+}
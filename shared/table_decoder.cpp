@@ -0,0 +1,253 @@
+#include "table_decoder.hpp"
+#include <algorithm>
+#include <ranges>
+#include <stdexcept>
+#include "bit_buffer.hpp"
+
+namespace tik
+{
+    TableDecoder::TableDecoder(const std::unordered_map<char, CodeTree::Code>& char_code)
+    {
+        if (!supports(char_code))
+            throw std::invalid_argument("Code is too long for table decoding");
+
+        if (char_code.size() == 1 && char_code.begin()->second.length == 0)
+        {
+            m_single = true;
+            m_single_symbol = char_code.begin()->first;
+            return;
+        }
+
+        std::vector<std::pair<char, CodeTree::Code>> codes(char_code.begin(), char_code.end());
+        build(codes);
+    }
+
+    TableDecoder::TableDecoder(const CodeTree::Lengths& lengths)
+    {
+        reset(lengths);
+    }
+
+    void TableDecoder::reset(const CodeTree::Lengths& lengths)
+    {
+        const auto codes = CodeTree::canonical_codes(lengths);
+        std::array<std::pair<char, CodeTree::Code>, 256> present;
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < codes.size(); ++i)
+        {
+            if (codes[i].length)
+                present[count++] = {static_cast<char>(i), codes[i]};
+        }
+        m_single = false;
+        build(std::span(present).first(count));
+    }
+
+    bool TableDecoder::supports(const std::unordered_map<char, CodeTree::Code>& char_code)
+    {
+        return std::ranges::all_of(char_code, [](const auto& pair)
+        {
+            return pair.second.length <= MAX_CODE_LENGTH;
+        });
+    }
+
+    void TableDecoder::build(Codes codes)
+    {
+        m_table.assign(1 << LOOKUP_BITS, Entry{{'\0', '\0'}, {0, 0}, 0, 0});
+        fill(0, LOOKUP_BITS, 0, codes);
+        pair_primary();
+    }
+
+    //Fills table at offset for codes with first depth bits already matched.
+    //Longer codes are sorted by their index in the table, so every next
+    //level table is filled from a contiguous group
+    void TableDecoder::fill(std::size_t offset, unsigned index_bits, unsigned depth, Codes codes)
+    {
+        const unsigned size = 1u << index_bits;
+        const auto index = [&](const std::pair<char, CodeTree::Code>& pair)
+        {
+            return static_cast<unsigned>((std::uint64_t(pair.second.value) >> depth) & (size - 1));
+        };
+
+        const auto longer = std::ranges::partition(codes, [&](const auto& pair)
+        {
+            return pair.second.length - depth <= index_bits;
+        }).begin();
+
+        for (const auto& [c, code] : std::ranges::subrange(codes.begin(), longer))
+        {
+            const unsigned left = code.length - depth;
+            const unsigned step = 1u << left;
+            for (unsigned i = (std::uint64_t(code.value) >> depth) & (step - 1); i < size; i += step)
+            {
+                m_table[offset + i] = Entry{{c, '\0'},
+                    {static_cast<std::uint8_t>(left), 0}, 0, 0};
+            }
+        }
+
+        std::ranges::sort(longer, codes.end(), std::ranges::less{}, index);
+        for (auto begin = longer; begin != codes.end();)
+        {
+            const unsigned prefix = index(*begin);
+            const auto end = std::find_if(begin, codes.end(), [&](const auto& pair)
+            {
+                return index(pair) != prefix;
+            });
+            const Codes group(begin, end);
+            begin = end;
+
+            unsigned max_left = 0;
+            for (const auto& [c, code] : group)
+                max_left = std::max(max_left, code.length - depth - index_bits);
+
+            const unsigned next_bits = std::min(max_left, LOOKUP_BITS);
+            const std::size_t next = m_table.size();
+            m_table.resize(next + (std::size_t(1) << next_bits), Entry{{'\0', '\0'}, {0, 0}, 0, 0});
+            m_table[offset + prefix].next = next;
+            m_table[offset + prefix].next_bits = next_bits;
+
+            fill(next, next_bits, depth + index_bits, group);
+        }
+    }
+
+    //Lets primary entries also resolve the code that follows a short one.
+    //Only the second symbol of an entry is written, so entries are read in
+    //place
+    void TableDecoder::pair_primary()
+    {
+        for (std::size_t i = 0; i < (std::size_t(1) << LOOKUP_BITS); ++i)
+        {
+            const Entry& first = m_table[i];
+            if (!first.lengths[0])
+                continue;
+
+            const Entry& second = m_table[i >> first.lengths[0]];
+            if (second.lengths[0] && first.lengths[0] + second.lengths[0] <= LOOKUP_BITS)
+            {
+                m_table[i].symbols[1] = second.symbols[0];
+                m_table[i].lengths[1] = second.lengths[0];
+            }
+        }
+    }
+
+    //Decodes one code, or two when the primary entry resolves a pair and
+    //pair is allowed. The reader has to be refilled
+    template <typename Reader>
+    char* TableDecoder::decode_entry(Reader& reader, char* out, bool pair) const
+    {
+        unsigned index_bits = LOOKUP_BITS;
+        const Entry* entry = &m_table[reader.peek(index_bits)];
+        while (!entry->lengths[0])
+        {
+            if (!entry->next_bits)
+                throw std::invalid_argument("Unknown bit sequence during decoding");
+
+            reader.consume(index_bits);
+            index_bits = entry->next_bits;
+            entry = &m_table[entry->next + reader.peek(index_bits)];
+        }
+
+        *out++ = entry->symbols[0];
+        reader.consume(entry->lengths[0]);
+
+        //With room for two symbols the second one is stored unconditionally
+        //and only counted when resolved
+        if (pair)
+        {
+            *out = entry->symbols[1];
+            reader.consume(entry->lengths[1]);
+            out += entry->lengths[1] != 0;
+        }
+        return out;
+    }
+
+    template <typename Reader>
+    void TableDecoder::decode_symbols(Reader& reader, char* out, std::size_t num_chars) const
+    {
+        if (m_single)
+        {
+            std::fill_n(out, num_chars, m_single_symbol);
+            return;
+        }
+
+        char* const end = out + num_chars;
+        while (out != end)
+        {
+            reader.refill();
+            out = decode_entry(reader, out, end - out > 1);
+        }
+    }
+
+    void TableDecoder::decode(std::istream& in, std::ostream& out, std::uintmax_t num_chars) const
+    {
+        std::vector<char> buffer(1 << 16);
+        utils::StreamBitReader reader(in);
+        while (num_chars)
+        {
+            const std::size_t n = std::min<std::uintmax_t>(num_chars, buffer.size());
+            decode_symbols(reader, buffer.data(), n);
+            out.write(buffer.data(), n);
+            num_chars -= n;
+        }
+    }
+
+    std::uint64_t TableDecoder::decode(std::span<const char> in, std::span<char> out) const
+    {
+        utils::BufferBitReader reader(in);
+        decode_symbols(reader, out.data(), out.size());
+        return reader.position();
+    }
+
+    std::array<std::uint64_t, TableDecoder::STREAMS> TableDecoder::decode_interleaved(
+        const std::array<std::span<const char>, STREAMS>& in, std::span<char> out) const
+    {
+        static_assert(STREAMS == 4);
+        std::array<utils::BufferBitReader, STREAMS> readers{
+            utils::BufferBitReader(in[0]), utils::BufferBitReader(in[1]),
+            utils::BufferBitReader(in[2]), utils::BufferBitReader(in[3])};
+
+        const std::size_t segment = segment_size(out.size());
+        std::array<char*, STREAMS> pos;
+        std::array<char*, STREAMS> end;
+        for (unsigned s = 0; s < STREAMS; ++s)
+        {
+            pos[s] = out.data() + std::min(s * segment, out.size());
+            end[s] = out.data() + std::min((s + 1) * segment, out.size());
+        }
+
+        if (!m_single)
+        {
+            //Lookups of different streams are independent, so they overlap
+            //instead of waiting on each other. A round takes at most two
+            //symbols from every stream, so no bounds are checked inside
+            while (true)
+            {
+                std::size_t rounds = segment;
+                for (unsigned s = 0; s < STREAMS; ++s)
+                    rounds = std::min<std::size_t>(rounds, (end[s] - pos[s]) / 2);
+                if (!rounds)
+                    break;
+
+                //Local copies stay in registers, stores of decoded symbols
+                //could alias the originals
+                auto local_readers = readers;
+                auto local_pos = pos;
+                for (; rounds; --rounds)
+                {
+                    for (unsigned s = 0; s < STREAMS; ++s)
+                        local_readers[s].refill();
+                    for (unsigned s = 0; s < STREAMS; ++s)
+                        local_pos[s] = decode_entry(local_readers[s], local_pos[s], true);
+                }
+                readers = local_readers;
+                pos = local_pos;
+            }
+        }
+
+        std::array<std::uint64_t, STREAMS> bits;
+        for (unsigned s = 0; s < STREAMS; ++s)
+        {
+            decode_symbols(readers[s], pos[s], end[s] - pos[s]);
+            bits[s] = readers[s].position();
+        }
+        return bits;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "tree.hpp"
+
+namespace tik
+{
+    //Decodes prefix codes by table lookup instead of walking the tree bit
+    //by bit. The primary table is indexed by the next LOOKUP_BITS bits of
+    //the stream and resolves up to two short codes at once; longer codes
+    //continue through linked next level tables.
+    class TableDecoder
+    {
+    public:
+        static constexpr unsigned LOOKUP_BITS = 11;
+        static constexpr unsigned MAX_CODE_LENGTH = 32;
+        //Interleaved blocks split their symbols into STREAMS segments of
+        //segment_size, the last one possibly shorter, each coded as its own
+        //bit stream with the same code
+        static constexpr unsigned STREAMS = 4;
+
+        static std::size_t segment_size(std::size_t block_size)
+        {
+            return (block_size + STREAMS - 1) / STREAMS;
+        }
+
+        //Has no table until reset
+        TableDecoder() = default;
+        explicit TableDecoder(const std::unordered_map<char, CodeTree::Code>& char_code);
+        //Builds tables for canonical codes straight from code lengths
+        explicit TableDecoder(const CodeTree::Lengths& lengths);
+
+        //Rebuilds the tables for other lengths in place, once they have
+        //grown to the longest code nothing is allocated
+        void reset(const CodeTree::Lengths& lengths);
+
+        static bool supports(const std::unordered_map<char, CodeTree::Code>& char_code);
+
+        void decode(std::istream& in, std::ostream& out, std::uintmax_t num_chars) const;
+        //Decodes out.size() symbols, returns the number of bits consumed
+        std::uint64_t decode(std::span<const char> in, std::span<char> out) const;
+        //Decodes an interleaved block advancing all stream readers in one
+        //loop, returns the number of bits consumed from every stream
+        std::array<std::uint64_t, STREAMS> decode_interleaved(
+            const std::array<std::span<const char>, STREAMS>& in, std::span<char> out) const;
+
+    private:
+        struct Entry
+        {
+            char symbols[2];
+            //Code lengths relative to the table level, 0 - not resolved
+            std::uint8_t lengths[2];
+            //Next level table, used when lengths[0] == 0
+            std::uint32_t next : 27;
+            std::uint32_t next_bits : 5;
+        };
+
+        using Codes = std::span<std::pair<char, CodeTree::Code>>;
+
+        //Codes are reordered while the tables are filled
+        void build(Codes codes);
+        void fill(std::size_t offset, unsigned index_bits, unsigned depth, Codes codes);
+        void pair_primary();
+
+        template <typename Reader>
+        char* decode_entry(Reader& reader, char* out, bool pair) const;
+        template <typename Reader>
+        void decode_symbols(Reader& reader, char* out, std::size_t num_chars) const;
+
+        std::vector<Entry> m_table;
+        bool m_single = false;
+        char m_single_symbol = '\0';
+    };
+}
@@ -0,0 +1,117 @@
+#include "table_encoder.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace tik
+{
+    TableEncoder::TableEncoder(const std::unordered_map<char, CodeTree::Code>& char_code)
+    {
+        if (!supports(char_code))
+            throw std::invalid_argument("Code is too long for table encoding");
+
+        if (char_code.size() == 1 && char_code.begin()->second.length == 0)
+        {
+            m_single = true;
+            m_single_symbol = char_code.begin()->first;
+            return;
+        }
+
+        for (const auto& [c, code] : char_code)
+        {
+            const auto i = static_cast<unsigned char>(c);
+            m_values[i] = code.value;
+            m_lengths[i] = code.length;
+            m_max_length = std::max(m_max_length, code.length);
+        }
+    }
+
+    TableEncoder::TableEncoder(const CodeTree::Lengths& lengths)
+    {
+        const auto codes = CodeTree::canonical_codes(lengths);
+        for (std::size_t i = 0; i < codes.size(); ++i)
+        {
+            m_values[i] = codes[i].value;
+            m_lengths[i] = codes[i].length;
+            m_max_length = std::max(m_max_length, codes[i].length);
+        }
+    }
+
+    bool TableEncoder::supports(const std::unordered_map<char, CodeTree::Code>& char_code)
+    {
+        return std::ranges::all_of(char_code, [](const auto& pair)
+        {
+            return pair.second.length <= MAX_CODE_LENGTH;
+        });
+    }
+
+    std::uint64_t TableEncoder::encoded_bits(const CodeTree::Counts& counts) const
+    {
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < counts.size(); ++i)
+            bits += counts[i] * m_lengths[i];
+        return bits;
+    }
+
+    std::size_t TableEncoder::max_encoded_size(std::size_t size) const
+    {
+        //Flushes may store a whole word past the last byte
+        return (size * m_max_length + 7) / 8 + 2 * sizeof(std::uint64_t);
+    }
+
+    //After a flush at most 7 bits are pending, so N codes of up to
+    //57 / N bits fit before the next store
+    template <unsigned N>
+    void TableEncoder::encode_packed(std::span<const unsigned char> in,
+                                     utils::BufferBitWriter& writer) const
+    {
+        unsigned min_length = 0xFF;
+        std::size_t i = 0;
+        for (; i + N <= in.size(); i += N)
+        {
+            for (unsigned k = 0; k < N; ++k)
+            {
+                const auto c = in[i + k];
+                writer.put(m_values[c], m_lengths[c]);
+                min_length = std::min<unsigned>(min_length, m_lengths[c]);
+            }
+            writer.flush();
+        }
+        for (; i < in.size(); ++i)
+        {
+            const auto c = in[i];
+            writer.put(m_values[c], m_lengths[c]);
+            min_length = std::min<unsigned>(min_length, m_lengths[c]);
+            writer.flush();
+        }
+
+        if (min_length == 0)
+            throw std::out_of_range("No code for symbol");
+    }
+
+    void TableEncoder::encode(std::span<const char> in, utils::BufferBitWriter& writer) const
+    {
+        if (m_single)
+        {
+            if (!std::ranges::all_of(in, [this](char c) { return c == m_single_symbol; }))
+                throw std::out_of_range("No code for symbol");
+            return;
+        }
+
+        writer.flush();
+        const std::span<const unsigned char> bytes(
+            reinterpret_cast<const unsigned char*>(in.data()), in.size());
+
+        if (m_max_length <= 9)
+            encode_packed<6>(bytes, writer);
+        else if (m_max_length <= 11)
+            encode_packed<5>(bytes, writer);
+        else if (m_max_length <= 14)
+            encode_packed<4>(bytes, writer);
+        else if (m_max_length <= 19)
+            encode_packed<3>(bytes, writer);
+        else if (m_max_length <= 28)
+            encode_packed<2>(bytes, writer);
+        else
+            encode_packed<1>(bytes, writer);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include "bit_buffer.hpp"
+#include "tree.hpp"
+
+namespace tik
+{
+    //Encodes through flat per byte code and length arrays, packing as
+    //many codes as fit into the 64 bit accumulator between stores
+    class TableEncoder
+    {
+    public:
+        static constexpr unsigned MAX_CODE_LENGTH = 32;
+
+        //Has no codes until assigned
+        TableEncoder() = default;
+        explicit TableEncoder(const std::unordered_map<char, CodeTree::Code>& char_code);
+        explicit TableEncoder(const CodeTree::Lengths& lengths);
+
+        static bool supports(const std::unordered_map<char, CodeTree::Code>& char_code);
+
+        std::uint64_t encoded_bits(const CodeTree::Counts& counts) const;
+
+        //Upper bound of bytes written by encode for size input bytes
+        std::size_t max_encoded_size(std::size_t size) const;
+
+        //Throws std::out_of_range for bytes without a code
+        void encode(std::span<const char> in, utils::BufferBitWriter& writer) const;
+
+    private:
+        template <unsigned N>
+        void encode_packed(std::span<const unsigned char> in, utils::BufferBitWriter& writer) const;
+
+        std::array<std::uint32_t, 256> m_values{};
+        std::array<std::uint8_t, 256> m_lengths{};
+        unsigned m_max_length = 0;
+        //A lone symbol with an empty code
+        bool m_single = false;
+        char m_single_symbol = '\0';
+    };
+}
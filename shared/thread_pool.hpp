@@ -0,0 +1,134 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tik
+{
+    namespace utils
+    {
+        class ThreadPool
+        {
+        public:
+            explicit ThreadPool(unsigned threads)
+            {
+                if (threads == 0)
+                    threads = 1;
+
+                m_threads.reserve(threads);
+                for (unsigned i = 0; i < threads; ++i)
+                    m_threads.emplace_back([this]() { run(); });
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            ~ThreadPool()
+            {
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_stop = true;
+                }
+                m_condition.notify_all();
+                for (auto& thread : m_threads)
+                    thread.join();
+            }
+
+            std::size_t size() const { return m_threads.size(); }
+
+            template <typename F>
+            auto submit(F&& f) -> std::future<std::invoke_result_t<F>>
+            {
+                using Result = std::invoke_result_t<F>;
+                auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+                auto future = task->get_future();
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_tasks.push([task]() { (*task)(); });
+                }
+                m_condition.notify_one();
+                return future;
+            }
+
+        private:
+            void run()
+            {
+                while (true)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock lock(m_mutex);
+                        m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+                        if (m_tasks.empty())
+                            return;
+
+                        task = std::move(m_tasks.front());
+                        m_tasks.pop();
+                    }
+                    task();
+                }
+            }
+
+            std::vector<std::thread> m_threads;
+            std::queue<std::function<void()>> m_tasks;
+            std::mutex m_mutex;
+            std::condition_variable m_condition;
+            bool m_stop = false;
+        };
+
+        //Runs process on items from produce in the pool and hands results to
+        //consume in the original order. At most window items are in flight
+        template <typename Produce, typename Process, typename Consume>
+        void ordered_for_each(ThreadPool& pool, Produce produce, Process process,
+                              Consume consume, std::size_t window = 0)
+        {
+            if (window == 0)
+                window = pool.size() * 2;
+
+            using Item = typename std::invoke_result_t<Produce>::value_type;
+            using Result = std::invoke_result_t<Process, Item>;
+            std::deque<std::future<Result>> pending;
+
+            try
+            {
+                while (auto item = produce())
+                {
+                    pending.push_back(pool.submit(
+                        [&process, item = std::move(*item)]() mutable
+                        {
+                            return process(std::move(item));
+                        }));
+
+                    if (pending.size() >= window)
+                    {
+                        consume(pending.front().get());
+                        pending.pop_front();
+                    }
+                }
+
+                while (!pending.empty())
+                {
+                    consume(pending.front().get());
+                    pending.pop_front();
+                }
+            }
+            catch (...)
+            {
+                //Tasks reference process, they have to finish before it goes
+                for (auto& future : pending)
+                {
+                    if (future.valid())
+                        future.wait();
+                }
+                throw;
+            }
+        }
+    }
+}
@@ -1,46 +1,1157 @@
 #include "tik.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bit_buffer.hpp"
+#include "fse.hpp"
+#include "histogram.hpp"
+#include "mapped_file.hpp"
+#include "table_decoder.hpp"
+#include "table_encoder.hpp"
+#include "thread_pool.hpp"
 
 namespace tik
 {
-    void encode_shannon_fano(const std::filesystem::path& from,
-                             const std::filesystem::path& to)
+    namespace
     {
-        std::ifstream in(from, std::ios::binary);
-        CodeTree tree = CodeTree::build_shannon_fano(in);
+        //Files without the magic are in the original format: serialized
+        //tree, text length and the code stream
+        constexpr std::array<char, 3> MAGIC = {'T', 'I', 'K'};
 
-        std::ofstream out(to, std::ios::binary);
-        CodeTree::serialize(tree, out);
-        out << std::filesystem::file_size(from);
+        enum class Format : std::uint8_t
+        {
+            CANONICAL = 1,
+            //Header, chunks and a trailing index of chunk offsets
+            CHUNKED = 2,
+            //Windows each with own code lengths, readable without seeking
+            STREAM = 3,
+            //Canonical code and blocks of interleaved code streams
+            INTERLEAVED = 4,
+            //STREAM windows coded with FSE instead of prefix codes
+            FSE = 5,
+            //Canonical code stream and a trailing index of checkpoints
+            SEEKABLE = 6
+        };
+
+        //Symbols per interleaved block
+        constexpr std::size_t INTERLEAVED_BLOCK = 1 << 18;
+
+        using Builder = CodeTree (*)(const CodeTree::Counts&, const EncodeOptions&);
+
+        CodeTree build_huffman(const CodeTree::Counts& counts, const EncodeOptions& options)
+        {
+            return CodeTree::build_huffman(counts, options.code_type, options.max_code_length);
+        }
+
+        CodeTree build_shannon_fano(const CodeTree::Counts& counts, const EncodeOptions& options)
+        {
+            return CodeTree::build_shannon_fano(counts, options.code_type);
+        }
+
+        void write_u64(std::ostream& out, std::uint64_t value)
+        {
+            for (unsigned i = 0; i < sizeof(value); ++i)
+                out.put(static_cast<char>(value >> (i * 8)));
+        }
+
+        std::uint64_t read_u64(std::istream& in)
+        {
+            std::uint64_t value = 0;
+            for (unsigned i = 0; i < sizeof(value); ++i)
+                value |= std::uint64_t(static_cast<unsigned char>(in.get())) << (i * 8);
+            if (!in)
+                throw std::invalid_argument("Unexpected end of header");
+            return value;
+        }
+
+        void write_header(std::ostream& out, const CodeTree& tree, std::uintmax_t num_chars,
+                          const EncodeOptions& options)
+        {
+            if (options.code_type == CodeTree::CodeType::CANONICAL)
+            {
+                out.write(MAGIC.data(), MAGIC.size());
+                out.put(static_cast<char>(Format::CANONICAL));
+                CodeTree::serialize_lengths(tree.lengths(), out);
+                write_u64(out, num_chars);
+            }
+            else
+            {
+                CodeTree::serialize(tree, out);
+                out << num_chars;
+            }
+        }
+
+        void encode_stream(const std::filesystem::path& from,
+                           const std::filesystem::path& to,
+                           Builder build, const EncodeOptions& options)
+        {
+            //Counting and coding read the same mapped pages
+            const utils::MappedFile input(from);
+            std::ofstream out(to, std::ios::binary);
+            //Empty input has no code, it is written as canonical lengths
+            //that are all zero
+            if (input.size() == 0)
+            {
+                out.write(MAGIC.data(), MAGIC.size());
+                out.put(static_cast<char>(Format::CANONICAL));
+                CodeTree::serialize_lengths(CodeTree::Lengths{}, out);
+                write_u64(out, 0);
+                return;
+            }
+
+            CodeTree tree = build(utils::histogram(input.data(), options.threads), options);
+            write_header(out, tree, input.size(), options);
+            tree.encode(input.data(), out);
+        }
+
+        //Every block is written as byte sizes of its streams followed by
+        //the streams
+        void encode_interleaved(const std::filesystem::path& from,
+                                const std::filesystem::path& to,
+                                Builder build, EncodeOptions options)
+        {
+            options.code_type = CodeTree::CodeType::CANONICAL;
+            const utils::MappedFile input(from);
+            const auto data = input.data();
+
+            CodeTree::Lengths lengths{};
+            if (!data.empty())
+                lengths = build(utils::histogram(data, options.threads), options).lengths();
+
+            std::ofstream out(to, std::ios::binary);
+            out.write(MAGIC.data(), MAGIC.size());
+            out.put(static_cast<char>(Format::INTERLEAVED));
+            CodeTree::serialize_lengths(lengths, out);
+            write_u64(out, data.size());
+            if (data.empty())
+                return;
+
+            constexpr unsigned STREAMS = TableDecoder::STREAMS;
+            const TableEncoder encoder(lengths);
+            std::array<std::vector<char>, STREAMS> buffers;
+            for (auto& buffer : buffers)
+                buffer.resize(encoder.max_encoded_size(TableDecoder::segment_size(INTERLEAVED_BLOCK)));
+
+            for (std::size_t offset = 0; offset < data.size(); offset += INTERLEAVED_BLOCK)
+            {
+                const auto block = data.subspan(offset, std::min(INTERLEAVED_BLOCK, data.size() - offset));
+                const std::size_t segment = TableDecoder::segment_size(block.size());
+
+                std::array<std::size_t, STREAMS> sizes;
+                for (unsigned s = 0; s < STREAMS; ++s)
+                {
+                    const std::size_t begin = std::min(s * segment, block.size());
+                    utils::BufferBitWriter writer(buffers[s]);
+                    encoder.encode(block.subspan(begin, std::min(segment, block.size() - begin)), writer);
+                    sizes[s] = writer.finish();
+                }
+
+                for (const auto size : sizes)
+                    write_u64(out, size);
+                for (unsigned s = 0; s < STREAMS; ++s)
+                    out.write(buffers[s].data(), sizes[s]);
+            }
+        }
+
+        //Header is followed by one code stream. The index holds the bit
+        //offset in the stream of every index_interval chars and the
+        //stream length in bits, the file ends with the index offset
+        void encode_seekable(const std::filesystem::path& from,
+                             const std::filesystem::path& to,
+                             Builder build, EncodeOptions options)
+        {
+            options.code_type = CodeTree::CodeType::CANONICAL;
+            const utils::MappedFile input(from);
+            const auto data = input.data();
+
+            CodeTree::Lengths lengths{};
+            if (!data.empty())
+                lengths = build(utils::histogram(data, options.threads), options).lengths();
+
+            std::ofstream out(to, std::ios::binary);
+            out.write(MAGIC.data(), MAGIC.size());
+            out.put(static_cast<char>(Format::SEEKABLE));
+            CodeTree::serialize_lengths(lengths, out);
+            write_u64(out, data.size());
+            write_u64(out, options.index_interval);
+
+            //Whole bytes are written after every interval, the pending
+            //bits carry over to the next one
+            std::vector<std::uint64_t> checkpoints;
+            std::uint64_t written_bits = 0;
+            if (!data.empty())
+            {
+                const TableEncoder encoder(lengths);
+                std::vector<char> buffer(encoder.max_encoded_size(std::min(options.index_interval, data.size())));
+                utils::BufferBitWriter writer(buffer);
+                for (std::size_t offset = 0; offset < data.size(); offset += options.index_interval)
+                {
+                    checkpoints.push_back(written_bits + writer.bits_written());
+                    encoder.encode(data.subspan(offset, std::min(options.index_interval, data.size() - offset)),
+                                   writer);
+                    writer.flush();
+                    out.write(buffer.data(), writer.size());
+                    written_bits += writer.size() * 8;
+                    writer.rewind();
+                }
+                written_bits += writer.bits_written();
+                out.write(buffer.data(), writer.finish());
+            }
+
+            const std::uint64_t index_offset = out.tellp();
+            write_u64(out, checkpoints.size());
+            for (const auto checkpoint : checkpoints)
+                write_u64(out, checkpoint);
+            write_u64(out, written_bits);
+            write_u64(out, index_offset);
+        }
+
+        struct ChunkIndex
+        {
+            std::uint64_t offset;
+            std::uint64_t bits;
+        };
+
+        //Chunk payload is code lengths followed by the code stream
+        struct EncodedChunk
+        {
+            std::string data;
+            std::uint64_t chars;
+            std::uint64_t bits;
+        };
+
+        EncodedChunk encode_chunk(std::span<const char> chunk, Builder build,
+                                  EncodeOptions options)
+        {
+            options.code_type = CodeTree::CodeType::CANONICAL;
+            const auto counts = CodeTree::count(chunk);
+            const auto lengths = build(counts, options).lengths();
+            const TableEncoder encoder(lengths);
+
+            std::ostringstream header;
+            CodeTree::serialize_lengths(lengths, header);
+
+            const std::uint64_t bits = encoder.encoded_bits(counts);
+            std::string data = std::move(header).str();
+            const std::size_t header_size = data.size();
+            data.resize(header_size + encoder.max_encoded_size(chunk.size()));
+
+            utils::BufferBitWriter writer(std::span<char>(data).subspan(header_size));
+            encoder.encode(chunk, writer);
+            data.resize(header_size + writer.finish());
+
+            return {std::move(data), chunk.size(), bits};
+        }
+
+        struct Chunk
+        {
+            std::string data;
+            std::uint64_t chars;
+            std::uint64_t bits;
+        };
+
+        std::string decode_chunk(Chunk chunk)
+        {
+            std::size_t header_size;
+            const auto lengths = CodeTree::deserialize_lengths(chunk.data, header_size);
+
+            const auto payload = std::span<const char>(chunk.data).subspan(header_size);
+            if (payload.size() != (chunk.bits + 7) / 8)
+                throw std::invalid_argument("Corrupted chunk");
+
+            std::string decoded(chunk.chars, '\0');
+            if (TableDecoder(lengths).decode(payload, decoded) != chunk.bits)
+                throw std::invalid_argument("Corrupted chunk");
+            return decoded;
+        }
+
+        //Window bytes, header included, that chars symbols take at most.
+        //Also bounds a chunk of HuffmanCompressor with the word a flush may
+        //store past its end
+        std::uint64_t max_window_size(std::uint64_t chars)
+        {
+            return CodeTree::MAX_LENGTHS_SIZE + (chars * CodeTree::MAX_CANONICAL_LENGTH + 7) / 8 + 2 * sizeof(std::uint64_t);
+        }
+
+        //FSE chunk payload is normalized counts followed by the FSE stream
+        EncodedChunk encode_fse_chunk(std::span<const char> chunk)
+        {
+            const auto normalized = FseCoder::normalize(CodeTree::count(chunk));
+            const FseCoder coder(normalized, FseCoder::DEFAULT_TABLE_LOG);
+
+            std::ostringstream header;
+            FseCoder::serialize(normalized, FseCoder::DEFAULT_TABLE_LOG, header);
+
+            std::string data = std::move(header).str();
+            const std::size_t header_size = data.size();
+            data.resize(header_size + coder.max_encoded_size(chunk.size()));
+
+            utils::BufferBitWriter writer(std::span<char>(data).subspan(header_size));
+            coder.encode(chunk, writer);
+            const std::uint64_t bits = writer.bits_written();
+            data.resize(header_size + writer.finish());
+
+            return {std::move(data), chunk.size(), bits};
+        }
+
+        std::string decode_fse_chunk(Chunk chunk)
+        {
+            unsigned table_log;
+            std::size_t header_size;
+            const auto normalized = FseCoder::deserialize(chunk.data, table_log, header_size);
+
+            const auto payload = std::span<const char>(chunk.data).subspan(header_size);
+            if (payload.size() != (chunk.bits + 7) / 8)
+                throw std::invalid_argument("Corrupted chunk");
+
+            std::string decoded(chunk.chars, '\0');
+            if (FseCoder(normalized, table_log).decode(payload, decoded) != chunk.bits)
+                throw std::invalid_argument("Corrupted chunk");
+            return decoded;
+        }
+
+        std::uint64_t max_fse_window_size(std::uint64_t chars)
+        {
+            return FseCoder::MAX_HEADER_SIZE + FseCoder::max_encoded_size(chars, FseCoder::MAX_TABLE_LOG);
+        }
+
+        void encode_chunked(const std::filesystem::path& from,
+                            const std::filesystem::path& to,
+                            Builder build, const EncodeOptions& options)
+        {
+            const utils::MappedFile input(from);
+            std::ofstream out(to, std::ios::binary);
+
+            out.write(MAGIC.data(), MAGIC.size());
+            out.put(static_cast<char>(Format::CHUNKED));
+            write_u64(out, input.size());
+            write_u64(out, options.chunk_size);
+
+            std::vector<ChunkIndex> index;
+            auto rest = input.data();
+            utils::ThreadPool pool(options.threads);
+            utils::ordered_for_each(
+                pool,
+                [&]() -> std::optional<std::span<const char>>
+                {
+                    if (rest.empty())
+                        return std::nullopt;
+                    const auto chunk = rest.first(std::min(options.chunk_size, rest.size()));
+                    rest = rest.subspan(chunk.size());
+                    return chunk;
+                },
+                [&](std::span<const char> chunk)
+                {
+                    return encode_chunk(chunk, build, options);
+                },
+                [&](EncodedChunk chunk)
+                {
+                    index.push_back({static_cast<std::uint64_t>(out.tellp()), chunk.bits});
+                    out.write(chunk.data.data(), chunk.data.size());
+                });
+
+            const std::uint64_t index_offset = out.tellp();
+            write_u64(out, index.size());
+            for (const auto& [offset, bits] : index)
+            {
+                write_u64(out, offset);
+                write_u64(out, bits);
+            }
+            write_u64(out, index_offset);
+        }
+
+        //Every window is written as its length, code stream bits, payload
+        //size and the payload. A zero length window ends the stream
+        template <typename Encode>
+        void encode_windows(std::istream& in, std::ostream& out, Format format,
+                            Encode encode_window, const EncodeOptions& options)
+        {
+            const std::size_t window = options.chunk_size ? options.chunk_size : DEFAULT_CHUNK_SIZE;
+
+            out.write(MAGIC.data(), MAGIC.size());
+            out.put(static_cast<char>(format));
+
+            utils::ThreadPool pool(options.threads);
+            utils::ordered_for_each(
+                pool,
+                [&]() -> std::optional<std::string>
+                {
+                    std::string chunk(window, '\0');
+                    in.read(chunk.data(), chunk.size());
+                    chunk.resize(in.gcount());
+                    if (chunk.empty())
+                        return std::nullopt;
+                    return chunk;
+                },
+                [&](std::string chunk)
+                {
+                    return encode_window(chunk);
+                },
+                [&](EncodedChunk chunk)
+                {
+                    write_u64(out, chunk.chars);
+                    write_u64(out, chunk.bits);
+                    write_u64(out, chunk.data.size());
+                    out.write(chunk.data.data(), chunk.data.size());
+                });
+
+            write_u64(out, 0);
+            out.flush();
+        }
+
+        void encode_windows(std::istream& in, std::ostream& out,
+                            Builder build, const EncodeOptions& options)
+        {
+            if (options.interleaved)
+                throw std::invalid_argument("Interleaved streams need a file input");
+            if (options.index_interval)
+                throw std::invalid_argument("Seekable streams need a file input");
+
+            encode_windows(in, out, Format::STREAM, [&](std::span<const char> chunk)
+            {
+                return encode_chunk(chunk, build, options);
+            }, options);
+        }
+
+        void encode(const std::filesystem::path& from,
+                    const std::filesystem::path& to,
+                    Builder build, const EncodeOptions& options)
+        {
+            if (options.index_interval)
+            {
+                if (options.chunk_size || options.interleaved)
+                    throw std::invalid_argument("Seekable streams can not be chunked or interleaved");
+                encode_seekable(from, to, build, options);
+            }
+            else if (options.interleaved)
+            {
+                if (options.chunk_size)
+                    throw std::invalid_argument("Interleaved streams can not be chunked");
+                encode_interleaved(from, to, build, options);
+            }
+            else if (options.chunk_size)
+                encode_chunked(from, to, build, options);
+            else
+                encode_stream(from, to, build, options);
+        }
+
+        //Seeks to the trailing index, returns its offset. Entries are
+        //read by the caller
+        std::uint64_t seek_index(std::istream& in)
+        {
+            in.seekg(-static_cast<std::streamoff>(sizeof(std::uint64_t)), std::ios::end);
+            const std::uint64_t index_offset = read_u64(in);
+            in.seekg(index_offset);
+            return index_offset;
+        }
+
+        struct ChunkedFile
+        {
+            std::uint64_t num_chars;
+            std::uint64_t chunk_size;
+            std::vector<ChunkIndex> index;
+            std::uint64_t index_offset;
+
+            //Reads header and index of a chunked file after the format
+            explicit ChunkedFile(std::istream& in)
+                : num_chars(read_u64(in)), chunk_size(read_u64(in)), index_offset(seek_index(in))
+            {
+                const std::uint64_t num_chunks = read_u64(in);
+                if (chunk_size == 0 || num_chunks != (num_chars + chunk_size - 1) / chunk_size)
+                    throw std::invalid_argument("Corrupted chunk index");
+
+                index.resize(num_chunks);
+                for (auto& [offset, bits] : index)
+                {
+                    offset = read_u64(in);
+                    bits = read_u64(in);
+                }
+            }
+
+            Chunk read_chunk(std::istream& in, std::size_t i) const
+            {
+                const auto begin = index[i].offset;
+                const auto end = i + 1 < index.size() ? index[i + 1].offset : index_offset;
+                Chunk chunk{std::string(end - begin, '\0'),
+                    std::min(chunk_size, num_chars - i * chunk_size), index[i].bits};
+
+                in.seekg(begin);
+                if (!in.read(chunk.data.data(), chunk.data.size()))
+                    throw std::invalid_argument("Unexpected end of chunk");
+                return chunk;
+            }
+        };
+
+        void decode_chunked(std::istream& in, std::ostream& out, unsigned threads)
+        {
+            const ChunkedFile file(in);
+
+            std::size_t next = 0;
+            utils::ThreadPool pool(threads);
+            utils::ordered_for_each(
+                pool,
+                [&]() -> std::optional<Chunk>
+                {
+                    if (next == file.index.size())
+                        return std::nullopt;
+                    return file.read_chunk(in, next++);
+                },
+                decode_chunk,
+                [&](std::string decoded)
+                {
+                    out.write(decoded.data(), decoded.size());
+                });
+        }
+
+        //Window lengths are bounded by max_size of their chars and, when the
+        //input seeks, by the bytes left, before they size a buffer
+        void decode_windows(std::istream& in, std::ostream& out, unsigned threads,
+                            std::string (*decode_window)(Chunk),
+                            std::uint64_t (*max_size)(std::uint64_t chars))
+        {
+            std::optional<std::uint64_t> end;
+            if (const auto position = in.tellg(); position != -1)
+            {
+                in.seekg(0, std::ios::end);
+                end = in.tellg();
+                in.seekg(position);
+            }
+
+            utils::ThreadPool pool(threads);
+            utils::ordered_for_each(
+                pool,
+                [&]() -> std::optional<Chunk>
+                {
+                    const std::uint64_t chars = read_u64(in);
+                    if (!chars)
+                        return std::nullopt;
+
+                    const std::uint64_t bits = read_u64(in);
+                    const std::uint64_t size = read_u64(in);
+                    //Larger counts would overflow the bound
+                    if (chars > std::numeric_limits<std::uint64_t>::max() / 64 || size > max_size(chars)
+                        || (end && size > *end - static_cast<std::uint64_t>(in.tellg())))
+                        throw std::invalid_argument("Unexpected end of window");
+
+                    Chunk chunk{std::string(size, '\0'), chars, bits};
+                    if (!in.read(chunk.data.data(), chunk.data.size()))
+                        throw std::invalid_argument("Unexpected end of window");
+                    return chunk;
+                },
+                decode_window,
+                [&](std::string decoded)
+                {
+                    out.write(decoded.data(), decoded.size());
+                });
+            out.flush();
+        }
+
+        void decode_interleaved(std::istream& in, std::ostream& out)
+        {
+            constexpr unsigned STREAMS = TableDecoder::STREAMS;
+            const auto lengths = CodeTree::deserialize_lengths(in);
+            std::uint64_t num_chars = read_u64(in);
+            if (!num_chars)
+                return;
+
+            const TableDecoder decoder(lengths);
+            std::vector<char> payload;
+            std::vector<char> block;
+            while (num_chars)
+            {
+                const std::size_t size = std::min<std::uint64_t>(num_chars, INTERLEAVED_BLOCK);
+
+                std::array<std::uint64_t, STREAMS> sizes;
+                std::uint64_t total = 0;
+                for (auto& stream_size : sizes)
+                {
+                    stream_size = read_u64(in);
+                    //Codes are at most 32 bits long
+                    if (stream_size > TableDecoder::segment_size(size) * sizeof(std::uint32_t))
+                        throw std::invalid_argument("Corrupted block");
+                    total += stream_size;
+                }
+
+                payload.resize(total);
+                if (!in.read(payload.data(), payload.size()))
+                    throw std::invalid_argument("Unexpected end of block");
+
+                std::array<std::span<const char>, STREAMS> streams;
+                std::size_t offset = 0;
+                for (unsigned s = 0; s < STREAMS; ++s)
+                {
+                    streams[s] = std::span<const char>(payload).subspan(offset, sizes[s]);
+                    offset += sizes[s];
+                }
+
+                block.resize(size);
+                const auto bits = decoder.decode_interleaved(streams, block);
+                for (unsigned s = 0; s < STREAMS; ++s)
+                {
+                    if ((bits[s] + 7) / 8 != sizes[s])
+                        throw std::invalid_argument("Corrupted block");
+                }
+
+                out.write(block.data(), block.size());
+                num_chars -= size;
+            }
+        }
+
+        //Range of the file clamped to num_chars, empty past the end
+        struct Range
+        {
+            std::uint64_t begin;
+            std::uint64_t end;
+        };
+
+        Range clamp(std::uint64_t offset, std::uint64_t length, std::uint64_t num_chars)
+        {
+            const std::uint64_t begin = std::min(offset, num_chars);
+            return {begin, begin + std::min(length, num_chars - begin)};
+        }
+
+        //Writes the part of decoded, which starts at first, inside range
+        void write_overlap(std::ostream& out, std::string_view decoded, std::uint64_t first, Range range)
+        {
+            const std::uint64_t begin = std::max(range.begin, first);
+            const std::uint64_t end = std::min(range.end, first + decoded.size());
+            out.write(decoded.data() + (begin - first), end - begin);
+        }
+
+        std::uint64_t decode_range_chunked(std::istream& in, std::ostream& out,
+                                           std::uint64_t offset, std::uint64_t length)
+        {
+            const ChunkedFile file(in);
+            const auto range = clamp(offset, length, file.num_chars);
+            for (std::uint64_t i = range.begin / file.chunk_size; i * file.chunk_size < range.end; ++i)
+                write_overlap(out, decode_chunk(file.read_chunk(in, i)), i * file.chunk_size, range);
+            return range.end - range.begin;
+        }
+
+        //Drops the first shift bits of a stream read lowest bit first
+        void skip_bits(std::string& data, unsigned shift)
+        {
+            if (!shift)
+                return;
+            for (std::size_t i = 0; i < data.size(); ++i)
+            {
+                const unsigned next = i + 1 < data.size() ? static_cast<unsigned char>(data[i + 1]) : 0;
+                data[i] = static_cast<char>((static_cast<unsigned char>(data[i]) >> shift) | (next << (8 - shift)));
+            }
+        }
+
+        //Reads the stream from the checkpoint before the range to the one
+        //after it and decodes it as one piece
+        std::uint64_t decode_range_seekable(std::istream& in, std::ostream& out,
+                                            std::uint64_t offset, std::uint64_t length)
+        {
+            const auto lengths = CodeTree::deserialize_lengths(in);
+            const std::uint64_t num_chars = read_u64(in);
+            const std::uint64_t interval = read_u64(in);
+            const std::uint64_t stream_offset = in.tellg();
+
+            //The count is checked against the header and the file before
+            //anything is sized by it
+            const std::uint64_t index_offset = seek_index(in);
+            const std::uint64_t count = read_u64(in);
+            if (interval == 0 || count != num_chars / interval + (num_chars % interval != 0))
+                throw std::invalid_argument("Corrupted checkpoint index");
+            in.seekg(0, std::ios::end);
+            //Count, checkpoints, stream end and the index offset
+            const std::uint64_t index_entries = (static_cast<std::uint64_t>(in.tellg()) - index_offset)
+                / sizeof(std::uint64_t);
+            if (index_entries < 3 || index_entries - 3 != count)
+                throw std::invalid_argument("Corrupted checkpoint index");
+            in.seekg(index_offset + sizeof(std::uint64_t));
+
+            std::vector<std::uint64_t> checkpoints(count);
+            for (auto& checkpoint : checkpoints)
+                checkpoint = read_u64(in);
+            //The stream end closes the last interval
+            checkpoints.push_back(read_u64(in));
+
+            const auto range = clamp(offset, length, num_chars);
+            if (range.begin == range.end)
+                return 0;
+
+            const std::uint64_t first = range.begin / interval;
+            const std::uint64_t last = (range.end - 1) / interval + 1;
+            const std::uint64_t begin_bit = checkpoints[first];
+            const std::uint64_t end_bit = checkpoints[last];
+            if (begin_bit > end_bit)
+                throw std::invalid_argument("Corrupted checkpoint index");
+
+            std::string payload((end_bit + 7) / 8 - begin_bit / 8, '\0');
+            in.seekg(stream_offset + begin_bit / 8);
+            if (!in.read(payload.data(), payload.size()))
+                throw std::invalid_argument("Unexpected end of stream");
+            skip_bits(payload, begin_bit % 8);
+
+            std::string decoded(std::min(last * interval, num_chars) - first * interval, '\0');
+            if (TableDecoder(lengths).decode(payload, decoded) != end_bit - begin_bit)
+                throw std::invalid_argument("Corrupted checkpoint");
+            write_overlap(out, decoded, first * interval, range);
+            return range.end - range.begin;
+        }
+
+        //Decodes everything after the magic
+        void decode_format(std::istream& in, std::ostream& out, unsigned threads,
+                           bool seekable)
+        {
+            const auto format = static_cast<Format>(in.get());
+            switch (format)
+            {
+            case Format::CANONICAL:
+            {
+                const auto lengths = CodeTree::deserialize_lengths(in);
+                const std::uintmax_t num_chars = read_u64(in);
+                if (num_chars)
+                    TableDecoder(lengths).decode(in, out, num_chars);
+                break;
+            }
+            case Format::CHUNKED:
+                if (!seekable)
+                    throw std::invalid_argument("Chunked format needs a seekable input");
+                decode_chunked(in, out, threads);
+                break;
+            case Format::STREAM:
+                decode_windows(in, out, threads, decode_chunk, max_window_size);
+                break;
+            case Format::INTERLEAVED:
+                decode_interleaved(in, out);
+                break;
+            case Format::FSE:
+                decode_windows(in, out, threads, decode_fse_chunk, max_fse_window_size);
+                break;
+            case Format::SEEKABLE:
+            {
+                //The stream decodes from the start without the index
+                const auto lengths = CodeTree::deserialize_lengths(in);
+                const std::uintmax_t num_chars = read_u64(in);
+                read_u64(in);
+                if (num_chars)
+                    TableDecoder(lengths).decode(in, out, num_chars);
+                break;
+            }
+            default:
+                throw std::invalid_argument("Unknown format");
+            }
+        }
+    }
 
-        in = std::ifstream(from, std::ios::binary);
-        tree.encode(in, out);
+    void encode_shannon_fano(const std::filesystem::path& from,
+                             const std::filesystem::path& to,
+                             const EncodeOptions& options)
+    {
+        encode(from, to, build_shannon_fano, options);
     }
 
     void encode_huffman(const std::filesystem::path& from,
-                        const std::filesystem::path& to)
+                        const std::filesystem::path& to,
+                        const EncodeOptions& options)
     {
-        std::ifstream in(from, std::ios::binary);
-        CodeTree tree = CodeTree::build_huffman(in);
+        encode(from, to, build_huffman, options);
+    }
+
+    void encode_shannon_fano(std::istream& in, std::ostream& out,
+                             const EncodeOptions& options)
+    {
+        encode_windows(in, out, build_shannon_fano, options);
+    }
+
+    void encode_huffman(std::istream& in, std::ostream& out,
+                        const EncodeOptions& options)
+    {
+        encode_windows(in, out, build_huffman, options);
+    }
 
+    void encode_fse(const std::filesystem::path& from,
+                    const std::filesystem::path& to,
+                    const EncodeOptions& options)
+    {
+        std::ifstream in(from, std::ios::binary);
         std::ofstream out(to, std::ios::binary);
-        CodeTree::serialize(tree, out);
-        out << std::filesystem::file_size(from);
+        encode_fse(in, out, options);
+    }
 
-        in = std::ifstream(from, std::ios::binary);
-        tree.encode(in, out);
+    void encode_fse(std::istream& in, std::ostream& out, const EncodeOptions& options)
+    {
+        encode_windows(in, out, Format::FSE, encode_fse_chunk, options);
     }
 
     void decode(const std::filesystem::path& from,
-                const std::filesystem::path& to)
+                const std::filesystem::path& to,
+                unsigned threads)
     {
         std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary);
+
+        std::array<char, MAGIC.size()> magic{};
+        in.read(magic.data(), magic.size());
+        if (in && magic == MAGIC)
+        {
+            decode_format(in, out, threads, true);
+            return;
+        }
+
+        in.clear();
+        in.seekg(0);
         auto tree = CodeTree::deserialize(in);
 
         std::uintmax_t num_chars;
         in >> num_chars;
 
-        std::ofstream out(to);
         tree.decode(in, out, num_chars);
     }
+
+    void decode(std::istream& in, std::ostream& out, unsigned threads)
+    {
+        std::array<char, MAGIC.size()> magic{};
+        in.read(magic.data(), magic.size());
+        if (!in || magic != MAGIC)
+            throw std::invalid_argument("Input is not in a streamable format");
+
+        decode_format(in, out, threads, false);
+    }
+
+    std::uint64_t decode_range(const std::filesystem::path& from, std::ostream& out,
+                               std::uint64_t offset, std::uint64_t length)
+    {
+        std::ifstream in(from, std::ios::binary);
+        std::array<char, MAGIC.size()> magic{};
+        in.read(magic.data(), magic.size());
+        if (!in || magic != MAGIC)
+            throw std::invalid_argument("Input has no index");
+
+        switch (static_cast<Format>(in.get()))
+        {
+        case Format::SEEKABLE:
+            return decode_range_seekable(in, out, offset, length);
+        case Format::CHUNKED:
+            return decode_range_chunked(in, out, offset, length);
+        default:
+            throw std::invalid_argument("Input has no index");
+        }
+    }
+
+    namespace
+    {
+        //Format of a buffer that starts with the magic
+        Format buffer_format(std::span<const char> in)
+        {
+            if (in.size() < MAGIC.size() + 1 || !std::equal(MAGIC.begin(), MAGIC.end(), in.begin()))
+                throw std::invalid_argument("Input is not in the tik format");
+            return static_cast<Format>(in[MAGIC.size()]);
+        }
+    }
+
+    HuffmanCompressor::HuffmanCompressor(std::size_t chunk_size, unsigned max_code_length)
+        : m_chunk_size(chunk_size), m_max_code_length(max_code_length)
+    {}
+
+    std::size_t HuffmanCompressor::max_compressed_size(std::size_t size) const
+    {
+        if (!m_chunk_size)
+            return MAGIC.size() + 1 + sizeof(std::uint64_t) + max_window_size(size);
+
+        const std::size_t rest = size % m_chunk_size;
+        const std::size_t chunks = size / m_chunk_size + (rest != 0);
+        return MAGIC.size() + 1 + 2 * sizeof(std::uint64_t)
+            + size / m_chunk_size * max_window_size(m_chunk_size) + (rest ? max_window_size(rest) : 0)
+            + (2 + 2 * chunks) * sizeof(std::uint64_t);
+    }
+
+    void HuffmanCompressor::build_code(std::span<const char> in)
+    {
+        m_counts = CodeTree::count(in);
+        m_lengths = CodeTree::huffman_lengths(m_counts, m_max_code_length);
+        m_encoder = TableEncoder(m_lengths);
+    }
+
+    std::size_t HuffmanCompressor::compress(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+        const std::size_t max_size = max_compressed_size(in.size());
+        if (out.size() < max_size)
+            throw std::invalid_argument("Output buffer is too small");
+
+        const auto input = utils::as_chars(in);
+        const auto output = utils::as_writable_chars(out);
+        std::copy(MAGIC.begin(), MAGIC.end(), output.begin());
+        std::size_t pos = MAGIC.size() + 1;
+
+        if (!m_chunk_size)
+        {
+            //Empty input is written with lengths that are all zero
+            output[MAGIC.size()] = static_cast<char>(Format::CANONICAL);
+            m_lengths = {};
+            if (!input.empty())
+                build_code(input);
+            pos += CodeTree::serialize_lengths(m_lengths, output.subspan(pos));
+            utils::store_u64_le(output.data() + pos, input.size());
+            pos += sizeof(std::uint64_t);
+            if (input.empty())
+                return pos;
+
+            utils::BufferBitWriter writer(output.subspan(pos));
+            m_encoder.encode(input, writer);
+            return pos + writer.finish();
+        }
+
+        output[MAGIC.size()] = static_cast<char>(Format::CHUNKED);
+        utils::store_u64_le(output.data() + pos, input.size());
+        utils::store_u64_le(output.data() + pos + sizeof(std::uint64_t), m_chunk_size);
+        pos += 2 * sizeof(std::uint64_t);
+
+        //Index entries are kept where max_compressed_size has room for
+        //them, past anything the chunks write, and moved behind the last
+        //chunk at the end
+        const std::size_t chunks = input.size() / m_chunk_size + (input.size() % m_chunk_size != 0);
+        char* const entries = output.data() + max_size - (1 + 2 * chunks) * sizeof(std::uint64_t);
+        for (std::size_t i = 0; i < chunks; ++i)
+        {
+            const auto chunk = input.subspan(i * m_chunk_size, std::min(m_chunk_size, input.size() - i * m_chunk_size));
+            build_code(chunk);
+            utils::store_u64_le(entries + 2 * i * sizeof(std::uint64_t), pos);
+            utils::store_u64_le(entries + (2 * i + 1) * sizeof(std::uint64_t), m_encoder.encoded_bits(m_counts));
+
+            pos += CodeTree::serialize_lengths(m_lengths, output.subspan(pos));
+            utils::BufferBitWriter writer(output.subspan(pos));
+            m_encoder.encode(chunk, writer);
+            pos += writer.finish();
+        }
+
+        const std::size_t index_offset = pos;
+        utils::store_u64_le(output.data() + pos, chunks);
+        pos += sizeof(std::uint64_t);
+        std::memmove(output.data() + pos, entries, 2 * chunks * sizeof(std::uint64_t));
+        pos += 2 * chunks * sizeof(std::uint64_t);
+        utils::store_u64_le(output.data() + pos, index_offset);
+        return pos + sizeof(std::uint64_t);
+    }
+
+    std::size_t HuffmanDecompressor::decompressed_size(std::span<const std::byte> in)
+    {
+        const auto input = utils::as_chars(in);
+        std::size_t pos = MAGIC.size() + 1;
+        switch (buffer_format(input))
+        {
+        case Format::CANONICAL:
+        {
+            std::size_t used;
+            CodeTree::deserialize_lengths(input.subspan(pos), used);
+            pos += used;
+            break;
+        }
+        case Format::CHUNKED:
+            break;
+        default:
+            throw std::invalid_argument("Input is not in the canonical or chunked format");
+        }
+
+        if (input.size() - pos < sizeof(std::uint64_t))
+            throw std::invalid_argument("Unexpected end of header");
+        return utils::load_u64_le(input.data() + pos);
+    }
+
+    std::size_t HuffmanDecompressor::decompress(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+        const std::uint64_t num_chars = decompressed_size(in);
+        const auto input = utils::as_chars(in);
+        const auto output = utils::as_writable_chars(out);
+        if (output.size() < num_chars)
+            throw std::invalid_argument("Output buffer is too small");
+
+        std::size_t pos = MAGIC.size() + 1;
+        if (buffer_format(input) == Format::CANONICAL)
+        {
+            //Without a bit count the stream is only checked to end in the input
+            std::size_t used;
+            const auto lengths = CodeTree::deserialize_lengths(input.subspan(pos), used);
+            const auto payload = input.subspan(pos + used + sizeof(std::uint64_t));
+            if (num_chars)
+            {
+                m_decoder.reset(lengths);
+                if (m_decoder.decode(payload, output.first(num_chars)) > payload.size() * 8)
+                    throw std::invalid_argument("Unexpected end of stream");
+            }
+            return num_chars;
+        }
+
+        pos += sizeof(std::uint64_t);
+        if (input.size() - pos < 2 * sizeof(std::uint64_t))
+            throw std::invalid_argument("Unexpected end of header");
+        const std::uint64_t chunk_size = utils::load_u64_le(input.data() + pos);
+        pos += sizeof(std::uint64_t);
+
+        const std::size_t index_end = input.size() - sizeof(std::uint64_t);
+        const std::uint64_t index_offset = utils::load_u64_le(input.data() + index_end);
+        if (chunk_size == 0 || index_offset < pos || index_offset > index_end
+            || index_end - index_offset < sizeof(std::uint64_t))
+            throw std::invalid_argument("Corrupted chunk index");
+
+        //Entries are checked against the index size before they are read
+        const std::uint64_t count = utils::load_u64_le(input.data() + index_offset);
+        const std::size_t index_size = index_end - index_offset - sizeof(std::uint64_t);
+        if (count != num_chars / chunk_size + (num_chars % chunk_size != 0)
+            || index_size % (2 * sizeof(std::uint64_t)) || index_size / (2 * sizeof(std::uint64_t)) != count)
+            throw std::invalid_argument("Corrupted chunk index");
+
+        const char* entries = input.data() + index_offset + sizeof(std::uint64_t);
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            const char* entry = entries + 2 * i * sizeof(std::uint64_t);
+            const std::uint64_t begin = utils::load_u64_le(entry);
+            const std::uint64_t bits = utils::load_u64_le(entry + sizeof(std::uint64_t));
+            const std::uint64_t end = i + 1 < count ? utils::load_u64_le(entry + 2 * sizeof(std::uint64_t))
+                                                    : index_offset;
+            if (begin < pos || begin > end || end > index_offset)
+                throw std::invalid_argument("Corrupted chunk index");
+
+            const auto chunk = input.subspan(begin, end - begin);
+            std::size_t used;
+            const auto lengths = CodeTree::deserialize_lengths(chunk, used);
+            const auto payload = chunk.subspan(used);
+            if (payload.size() != (bits + 7) / 8)
+                throw std::invalid_argument("Corrupted chunk");
+
+            m_decoder.reset(lengths);
+            const auto decoded = output.subspan(i * chunk_size, std::min(chunk_size, num_chars - i * chunk_size));
+            if (m_decoder.decode(payload, decoded) != bits)
+                throw std::invalid_argument("Corrupted chunk");
+        }
+        return num_chars;
+    }
+
+    FseCompressor::FseCompressor(std::size_t window)
+        : m_window(window ? window : DEFAULT_CHUNK_SIZE)
+    {}
+
+    std::size_t FseCompressor::max_compressed_size(std::size_t size) const
+    {
+        const auto window_size = [](std::size_t chars)
+        {
+            return 3 * sizeof(std::uint64_t) + FseCoder::MAX_HEADER_SIZE
+                + FseCoder::max_encoded_size(chars, FseCoder::DEFAULT_TABLE_LOG);
+        };
+        const std::size_t rest = size % m_window;
+        return MAGIC.size() + 1 + size / m_window * window_size(m_window)
+            + (rest ? window_size(rest) : 0) + sizeof(std::uint64_t);
+    }
+
+    std::size_t FseCompressor::compress(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+        if (out.size() < max_compressed_size(in.size()))
+            throw std::invalid_argument("Output buffer is too small");
+
+        const auto input = utils::as_chars(in);
+        const auto output = utils::as_writable_chars(out);
+        std::copy(MAGIC.begin(), MAGIC.end(), output.begin());
+        output[MAGIC.size()] = static_cast<char>(Format::FSE);
+        std::size_t pos = MAGIC.size() + 1;
+
+        //Same windows as encode_fse, the payload is coded in place after
+        //the window header
+        for (std::size_t offset = 0; offset < input.size(); offset += m_window)
+        {
+            const auto chunk = input.subspan(offset, std::min(m_window, input.size() - offset));
+            const auto normalized = FseCoder::normalize(CodeTree::count(chunk));
+            m_coder.reset(normalized, FseCoder::DEFAULT_TABLE_LOG);
+
+            char* header = output.data() + pos;
+            pos += 3 * sizeof(std::uint64_t);
+            const std::size_t header_size = FseCoder::serialize(normalized, FseCoder::DEFAULT_TABLE_LOG,
+                                                                output.subspan(pos));
+
+            utils::BufferBitWriter writer(output.subspan(pos + header_size));
+            m_coder.encode(chunk, writer, m_symbol_bits);
+            const std::uint64_t bits = writer.bits_written();
+            const std::size_t payload_size = header_size + writer.finish();
+
+            utils::store_u64_le(header, chunk.size());
+            utils::store_u64_le(header + sizeof(std::uint64_t), bits);
+            utils::store_u64_le(header + 2 * sizeof(std::uint64_t), payload_size);
+            pos += payload_size;
+        }
+
+        utils::store_u64_le(output.data() + pos, 0);
+        return pos + sizeof(std::uint64_t);
+    }
+
+    namespace
+    {
+        struct Window
+        {
+            std::uint64_t chars;
+            std::uint64_t bits;
+            std::span<const char> payload;
+        };
+
+        //Calls visit for every window of an FSE buffer, returns the total
+        //number of chars
+        template <typename Visit>
+        std::uint64_t for_each_window(std::span<const char> in, Visit visit)
+        {
+            if (in.size() < MAGIC.size() + 1 || !std::equal(MAGIC.begin(), MAGIC.end(), in.begin())
+                || static_cast<Format>(in[MAGIC.size()]) != Format::FSE)
+                throw std::invalid_argument("Input is not in the FSE format");
+
+            std::uint64_t total = 0;
+            std::size_t pos = MAGIC.size() + 1;
+            while (true)
+            {
+                if (in.size() - pos < sizeof(std::uint64_t))
+                    throw std::invalid_argument("Unexpected end of header");
+                const std::uint64_t chars = utils::load_u64_le(in.data() + pos);
+                if (!chars)
+                    return total;
+
+                if (in.size() - pos < 3 * sizeof(std::uint64_t))
+                    throw std::invalid_argument("Unexpected end of header");
+                const std::uint64_t bits = utils::load_u64_le(in.data() + pos + sizeof(std::uint64_t));
+                const std::uint64_t size = utils::load_u64_le(in.data() + pos + 2 * sizeof(std::uint64_t));
+                pos += 3 * sizeof(std::uint64_t);
+                if (in.size() - pos < size)
+                    throw std::invalid_argument("Unexpected end of chunk");
+
+                visit(Window{chars, bits, in.subspan(pos, size)}, total);
+                total += chars;
+                pos += size;
+            }
+        }
+    }
+
+    std::size_t FseDecompressor::decompressed_size(std::span<const std::byte> in)
+    {
+        return for_each_window(utils::as_chars(in), [](const Window&, std::uint64_t) {});
+    }
+
+    std::size_t FseDecompressor::decompress(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+        const auto output = utils::as_writable_chars(out);
+        return for_each_window(utils::as_chars(in), [&](const Window& window, std::uint64_t offset)
+        {
+            if (output.size() - offset < window.chars)
+                throw std::invalid_argument("Output buffer is too small");
+
+            unsigned table_log;
+            std::size_t header_size;
+            const auto normalized = FseCoder::deserialize(window.payload, table_log, header_size);
+            m_coder.reset(normalized, table_log);
+
+            const auto payload = window.payload.subspan(header_size);
+            if (payload.size() != (window.bits + 7) / 8
+                || m_coder.decode(payload, output.subspan(offset, window.chars)) != window.bits)
+                throw std::invalid_argument("Corrupted chunk");
+        });
+    }
 }
@@ -1,14 +1,154 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <filesystem>
+#include <span>
+#include <vector>
+#include "fse.hpp"
+#include "table_decoder.hpp"
+#include "table_encoder.hpp"
 #include "tree.hpp"
 
 namespace tik
 {
+    constexpr std::size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+    struct EncodeOptions
+    {
+        CodeTree::CodeType code_type = CodeTree::CodeType::ARBITRARY;
+        //Huffman codes are limited so they always fit CodeTree::Code
+        unsigned max_code_length = CodeTree::MAX_CANONICAL_LENGTH;
+        //Independently coded chunks with own canonical codes, 0 - one code
+        //stream for the whole file. Window size for stream encoding
+        std::size_t chunk_size = 0;
+        unsigned threads = 1;
+        //One canonical code for the file with every block split into
+        //TableDecoder::STREAMS code streams decoded side by side. Not
+        //combinable with chunks or stream encoding
+        bool interleaved = false;
+        //One canonical code stream with a checkpoint of its bit offset
+        //every index_interval bytes, kept in a trailing index so
+        //decode_range starts near its offset. 0 - no index. Not
+        //combinable with chunks, interleaving or stream encoding
+        std::size_t index_interval = 0;
+    };
+
     void encode_shannon_fano(const std::filesystem::path& from,
-                             const std::filesystem::path& to);
+                             const std::filesystem::path& to,
+                             const EncodeOptions& options = {});
     void encode_huffman(const std::filesystem::path& from,
-                        const std::filesystem::path& to);
+                        const std::filesystem::path& to,
+                        const EncodeOptions& options = {});
+    //Windows of chunk_size bytes (DEFAULT_CHUNK_SIZE if 0) coded with
+    //FseCoder on threads, code type options are not used
+    void encode_fse(const std::filesystem::path& from,
+                    const std::filesystem::path& to,
+                    const EncodeOptions& options = {});
     void decode(const std::filesystem::path& from,
-                const std::filesystem::path& to);
+                const std::filesystem::path& to,
+                unsigned threads = 1);
+
+    //Writes length bytes from offset of a file with an index, decoding
+    //only the checkpoints or chunks that hold them. Bytes past the end
+    //are not written, returns the number of bytes written. Throws
+    //std::invalid_argument for files without an index
+    std::uint64_t decode_range(const std::filesystem::path& from, std::ostream& out,
+                               std::uint64_t offset, std::uint64_t length);
+
+    //Streaming variants, input is coded in bounded windows that are
+    //decodable without seeking
+    void encode_shannon_fano(std::istream& in, std::ostream& out,
+                             const EncodeOptions& options = {});
+    void encode_huffman(std::istream& in, std::ostream& out,
+                        const EncodeOptions& options = {});
+    void encode_fse(std::istream& in, std::ostream& out,
+                    const EncodeOptions& options = {});
+    void decode(std::istream& in, std::ostream& out, unsigned threads = 1);
+
+    //Compresses memory buffers into the format of encode_huffman with
+    //canonical codes, in chunks of chunk_size bytes unless it is 0. The
+    //output is the same as of the file encoder and decodes with decode.
+    //Histogram, lengths and code tables are kept between calls, compress
+    //only allocates when a code has to be length limited. Not to be
+    //shared between threads
+    class HuffmanCompressor
+    {
+    public:
+        explicit HuffmanCompressor(std::size_t chunk_size = 0,
+                                   unsigned max_code_length = CodeTree::MAX_CANONICAL_LENGTH);
+
+        //Output buffer size that fits any input of size bytes
+        std::size_t max_compressed_size(std::size_t size) const;
+
+        //Returns the bytes written. Throws std::invalid_argument when out
+        //is smaller than max_compressed_size(in.size())
+        std::size_t compress(std::span<const std::byte> in, std::span<std::byte> out);
+
+    private:
+        //Counts, lengths and encoder for the code of in
+        void build_code(std::span<const char> in);
+
+        std::size_t m_chunk_size;
+        unsigned m_max_code_length;
+        CodeTree::Counts m_counts{};
+        CodeTree::Lengths m_lengths{};
+        TableEncoder m_encoder;
+    };
+
+    //Decompresses buffers of the canonical and chunked Huffman or
+    //Shannon-Fano formats. Decode tables are rebuilt in place, after the
+    //first calls decompress does not allocate
+    class HuffmanDecompressor
+    {
+    public:
+        //Reads the header only. Throws std::invalid_argument for other
+        //formats and truncated input
+        static std::size_t decompressed_size(std::span<const std::byte> in);
+
+        //Returns the bytes written, out holds at least decompressed_size
+        std::size_t decompress(std::span<const std::byte> in, std::span<std::byte> out);
+
+    private:
+        TableDecoder m_decoder;
+    };
+
+    //Compresses memory buffers into the format of encode_fse. The output
+    //also decodes with decode. Tables and scratch buffers are kept
+    //between calls, once they have grown to the window size compress
+    //does not allocate. Not to be shared between threads
+    class FseCompressor
+    {
+    public:
+        explicit FseCompressor(std::size_t window = DEFAULT_CHUNK_SIZE);
+
+        //Output buffer size that fits any input of size bytes
+        std::size_t max_compressed_size(std::size_t size) const;
+
+        //Returns the bytes written. Throws std::invalid_argument when out
+        //is smaller than max_compressed_size(in.size())
+        std::size_t compress(std::span<const std::byte> in, std::span<std::byte> out);
+
+    private:
+        std::size_t m_window;
+        FseCoder m_coder;
+        std::vector<std::uint32_t> m_symbol_bits;
+    };
+
+    //Decompresses buffers of the encode_fse format only, Huffman and
+    //Shannon-Fano buffers go through HuffmanDecompressor. After the first call
+    //decompress only allocates when the coder table log grows
+    class FseDecompressor
+    {
+    public:
+        //Reads window headers only. Throws std::invalid_argument for non-FSE
+        //formats and truncated input
+        static std::size_t decompressed_size(std::span<const std::byte> in);
+
+        //Returns the bytes written, out holds at least decompressed_size
+        std::size_t decompress(std::span<const std::byte> in, std::span<std::byte> out);
+
+    private:
+        FseCoder m_coder;
+    };
 }
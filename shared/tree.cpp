@@ -1,10 +1,14 @@
 #include "tree.hpp"
 #include <cassert>
 #include <exception>
-#include <map>
+#include <limits>
+#include <stdexcept>
 #include <ranges>
 #include <algorithm>
-#include "bit_writer.hpp"
+#include "bit_buffer.hpp"
+#include "histogram.hpp"
+#include "table_decoder.hpp"
+#include "table_encoder.hpp"
 
 namespace tik
 {
@@ -39,25 +43,221 @@ namespace tik
         return CodeTree(std::move(char_code));
     }
 
-    CodeTree CodeTree::build_shannon_fano(std::istream &in)
+    namespace
     {
-        std::map<char, unsigned> counts;
+        //Lengths are run length encoded one byte per token:
+        //0b00LLLLLL - code length L, 0b01NNNNNN - previous length N + 1 times,
+        //0b1NNNNNNN - N + 1 absent symbols. Every token covers at least one
+        //symbol
+        template <typename Put>
+        void write_lengths(const CodeTree::Lengths& lengths, Put put)
+        {
+            std::size_t i = 0;
+            while (i < lengths.size())
+            {
+                std::size_t run = 1;
+                while (i + run < lengths.size() && lengths[i + run] == lengths[i])
+                    ++run;
+
+                if (lengths[i] == 0)
+                {
+                    run = std::min<std::size_t>(run, 128);
+                    put(static_cast<char>(0x80 | (run - 1)));
+                }
+                else
+                {
+                    put(static_cast<char>(lengths[i]));
+                    run = std::min<std::size_t>(run - 1, 64);
+                    if (run)
+                        put(static_cast<char>(0x40 | (run - 1)));
+                    ++run;
+                }
+                i += run;
+            }
+        }
+    }
+
+    void CodeTree::serialize_lengths(const Lengths& lengths, std::ostream& out)
+    {
+        write_lengths(lengths, [&](char token) { out.put(token); });
+    }
+
+    std::size_t CodeTree::serialize_lengths(const Lengths& lengths, std::span<char> out)
+    {
+        std::size_t used = 0;
+        write_lengths(lengths, [&](char token) { out[used++] = token; });
+        return used;
+    }
+
+    namespace
+    {
+        //next_token returns the next length token or EOF
+        template <typename NextToken>
+        CodeTree::Lengths parse_lengths(NextToken next_token)
+        {
+            CodeTree::Lengths lengths{};
+            std::size_t i = 0;
+            while (i < lengths.size())
+            {
+                const int token = next_token();
+                if (token == std::char_traits<char>::eof())
+                    throw std::invalid_argument("Unexpected end of code lengths");
+
+                std::size_t run;
+                std::uint8_t length;
+                if (token & 0x80)
+                {
+                    run = (token & 0x7F) + 1;
+                    length = 0;
+                }
+                else if (token & 0x40)
+                {
+                    if (i == 0)
+                        throw std::invalid_argument("Repeat without previous code length");
+                    run = (token & 0x3F) + 1;
+                    length = lengths[i - 1];
+                }
+                else
+                {
+                    run = 1;
+                    length = token;
+                }
+
+                if (i + run > lengths.size())
+                    throw std::invalid_argument("Too many code lengths");
+
+                std::fill_n(lengths.begin() + i, run, length);
+                i += run;
+            }
+            return lengths;
+        }
+    }
+
+    CodeTree::Lengths CodeTree::deserialize_lengths(std::istream& in)
+    {
+        return parse_lengths([&]() { return in.get(); });
+    }
+
+    CodeTree::Lengths CodeTree::deserialize_lengths(std::span<const char> in, std::size_t& used)
+    {
+        used = 0;
+        return parse_lengths([&]()
+        {
+            if (used == in.size())
+                return std::char_traits<char>::eof();
+            return int(static_cast<unsigned char>(in[used++]));
+        });
+    }
+
+    //Codes are assigned in order of (length, symbol) like in deflate. As
+    //the first bit of a code is stored in the lowest bit of Code::value, the
+    //canonical code is stored bit reversed
+    std::array<CodeTree::Code, 256> CodeTree::canonical_codes(const Lengths& lengths)
+    {
+        std::array<unsigned, MAX_CANONICAL_LENGTH + 1> count{};
+        std::uint64_t kraft = 0;
+        for (const auto length : lengths)
+        {
+            if (length > MAX_CANONICAL_LENGTH)
+                throw std::invalid_argument("Code length exceeds 32 bits");
+            if (length)
+            {
+                ++count[length];
+                kraft += std::uint64_t(1) << (MAX_CANONICAL_LENGTH - length);
+            }
+        }
+        if (kraft > (std::uint64_t(1) << MAX_CANONICAL_LENGTH))
+            throw std::invalid_argument("Code lengths do not form a prefix code");
+
+        std::array<std::uint64_t, MAX_CANONICAL_LENGTH + 1> next{};
+        std::uint64_t code = 0;
+        for (unsigned length = 1; length <= MAX_CANONICAL_LENGTH; ++length)
+        {
+            code = (code + count[length - 1]) << 1;
+            next[length] = code;
+        }
+
+        std::array<Code, 256> codes{};
+        for (std::size_t i = 0; i < lengths.size(); ++i)
+        {
+            const unsigned length = lengths[i];
+            if (!length)
+                continue;
+
+            const std::uint64_t canonical = next[length]++;
+            unsigned reversed = 0;
+            for (unsigned bit = 0; bit < length; ++bit)
+                reversed |= ((canonical >> (length - bit - 1)) & 1) << bit;
+
+            codes[i] = {reversed, length};
+        }
+        return codes;
+    }
 
-        unsigned sum = 0;
-        char c;
-        while (in.get(c))
+    CodeTree CodeTree::canonical(const Lengths& lengths)
+    {
+        const auto codes = canonical_codes(lengths);
+        std::unordered_map<char, Code> char_code;
+        for (std::size_t i = 0; i < codes.size(); ++i)
         {
-            ++counts[c];
-            ++sum;
+            if (codes[i].length)
+                char_code[static_cast<char>(i)] = codes[i];
         }
+        return CodeTree(std::move(char_code));
+    }
+
+    //A lone symbol has an empty code, it gets a one bit code instead as
+    //length 0 marks absent symbols
+    CodeTree::Lengths CodeTree::lengths() const
+    {
+        Lengths result{};
+        for (const auto& [c, code] : m_char_code)
+        {
+            result[static_cast<unsigned char>(c)] = std::max(code.length, 1u);
+        }
+        return result;
+    }
+
+    CodeTree::Counts CodeTree::count(std::istream& in)
+    {
+        Counts counts{};
+        std::vector<char> buffer(1 << 16);
+        while (in.read(buffer.data(), buffer.size()) || in.gcount())
+        {
+            const auto partial = utils::histogram(std::span(buffer.data(), in.gcount()));
+            for (std::size_t i = 0; i < counts.size(); ++i)
+                counts[i] += partial[i];
+        }
+        return counts;
+    }
+
+    CodeTree::Counts CodeTree::count(std::span<const char> in)
+    {
+        return utils::histogram(in);
+    }
+
+    CodeTree CodeTree::build_shannon_fano(std::istream &in, CodeType type)
+    {
+        return build_shannon_fano(count(in), type);
+    }
+
+    CodeTree CodeTree::build_shannon_fano(const Counts& counts, CodeType type)
+    {
+        std::uint64_t sum = 0;
+        for (const auto n : counts)
+            sum += n;
 
         std::vector<std::pair<double, char>> probabilities;
-        probabilities.reserve(counts.size());
 
-        for (const auto& [c, n] : counts)
+        for (std::size_t i = 0; i < counts.size(); ++i)
         {
-            probabilities.push_back(std::make_pair(n/static_cast<double>(sum), c));
+            if (counts[i])
+                probabilities.push_back(std::make_pair(counts[i]/static_cast<double>(sum),
+                                                       static_cast<char>(i)));
         }
+
+        if (probabilities.empty())
+            throw std::invalid_argument("Cannot build a code for empty input");
         std::ranges::sort(probabilities);
 
         auto build_tree = [] (auto begin, auto end, auto& self_ref, auto* parent)
@@ -108,30 +308,114 @@ namespace tik
         auto root = std::make_unique<Node>(Node{nullptr, nullptr, {'\0', 0}, '\0'});
         build_tree(probabilities.begin(), probabilities.end(), build_tree, root.get());
 
-        return CodeTree(std::move(root));
+        CodeTree tree(std::move(root));
+        if (type == CodeType::CANONICAL)
+            return canonical(tree.lengths());
+        return tree;
     }
 
-    CodeTree CodeTree::build_huffman(std::istream& in)
+    CodeTree::Lengths CodeTree::length_limited(const Counts& counts,
+                                               unsigned max_length)
     {
-        std::map<char, unsigned> counts;
+        struct Item
+        {
+            std::uint64_t weight;
+            int symbol;            //-1 for packages
+            std::size_t children;  //first of two items in the deeper list
+        };
 
-        unsigned sum = 0;
-        char c;
-        while (in.get(c))
+        std::vector<Item> leaves;
+        for (std::size_t i = 0; i < counts.size(); ++i)
         {
-            ++counts[c];
-            ++sum;
+            if (counts[i])
+                leaves.push_back({counts[i], static_cast<int>(i), 0});
         }
+        std::ranges::stable_sort(leaves, std::ranges::less{}, &Item::weight);
+
+        Lengths lengths{};
+        if (leaves.size() == 1)
+            lengths[leaves.front().symbol] = 1;
+        if (leaves.size() <= 1)
+            return lengths;
+
+        if (max_length >= 64 || (std::size_t(1) << max_length) < leaves.size())
+            throw std::invalid_argument("Maximal code length is too small for the alphabet");
+
+        //lists[l] holds candidates for code length l + 1, packages pair
+        //up items of lists[l + 1]
+        std::vector<std::vector<Item>> lists(max_length);
+        lists.back() = leaves;
+        for (std::size_t l = max_length - 1; l-- > 0;)
+        {
+            const auto& deeper = lists[l + 1];
+            auto& list = lists[l];
+            list.reserve(leaves.size() + deeper.size() / 2);
 
-        std::vector<std::pair<unsigned, std::unique_ptr<Node>>> nodes;
-        nodes.reserve(counts.size());
+            std::size_t leaf = 0;
+            std::size_t pair = 0;
+            while (leaf < leaves.size() || pair + 1 < deeper.size())
+            {
+                const bool take_package = pair + 1 < deeper.size()
+                    && (leaf == leaves.size()
+                        || deeper[pair].weight + deeper[pair + 1].weight < leaves[leaf].weight);
+                if (take_package)
+                {
+                    list.push_back({deeper[pair].weight + deeper[pair + 1].weight, -1, pair});
+                    pair += 2;
+                }
+                else
+                {
+                    list.push_back(leaves[leaf++]);
+                }
+            }
+        }
 
-        for (const auto& [c, n] : counts)
+        auto count_item = [&](std::size_t l, std::size_t index, const auto& self_ref) -> void
         {
+            const Item& item = lists[l][index];
+            if (item.symbol >= 0)
+            {
+                ++lengths[item.symbol];
+                return;
+            }
+            self_ref(l + 1, item.children, self_ref);
+            self_ref(l + 1, item.children + 1, self_ref);
+        };
+
+        for (std::size_t i = 0; i < 2 * leaves.size() - 2; ++i)
+            count_item(0, i, count_item);
+
+        return lengths;
+    }
+
+    CodeTree CodeTree::build_huffman(std::istream& in, CodeType type, unsigned max_length)
+    {
+        return build_huffman(count(in), type, max_length);
+    }
+
+    CodeTree CodeTree::build_huffman(const Counts& counts, CodeType type, unsigned max_length)
+    {
+        if (type == CodeType::CANONICAL)
+            return canonical(huffman_lengths(counts, max_length));
+
+        std::vector<std::pair<std::uint64_t, std::unique_ptr<Node>>> nodes;
+
+        //Symbols are taken in char order, ties are broken the same way for
+        //every platform
+        for (int i = std::numeric_limits<char>::min(); i <= std::numeric_limits<char>::max(); ++i)
+        {
+            const char c = static_cast<char>(i);
+            const auto n = counts[static_cast<unsigned char>(c)];
+            if (!n)
+                continue;
+
             auto node = std::make_unique<Node>(Node{nullptr, nullptr, {0, 0}, c});
             nodes.push_back(std::make_pair(n, std::move(node)));
         }
 
+        if (nodes.empty())
+            throw std::invalid_argument("Cannot build a code for empty input");
+
         auto cmp = [](const auto& lhs, const auto& rhs)
         {
             return lhs.first > rhs.first;
@@ -156,6 +440,20 @@ namespace tik
             std::ranges::push_heap(nodes, cmp);
         }
 
+        //Skewed counts grow trees deeper than a Code holds, so only the
+        //depth is taken before any code value is built
+        auto depth = [] (const Node* parent, const auto& self_ref) -> unsigned
+        {
+            if (parent->is_leaf())
+                return 0;
+            return 1 + std::max(parent->left ? self_ref(parent->left.get(), self_ref) : 0u,
+                                parent->right ? self_ref(parent->right.get(), self_ref) : 0u);
+        };
+
+        const unsigned limit = max_length ? max_length : MAX_CANONICAL_LENGTH;
+        if (depth(nodes.front().second.get(), depth) > limit)
+            return canonical(length_limited(counts, limit));
+
         auto update = [] (const auto* parent, const auto& self_ref) -> void
         {
             if (parent->left)
@@ -167,7 +465,7 @@ namespace tik
 
             if (parent->right)
             {
-                const Code right_code = {parent->code.value | (1 << (parent->code.length)),
+                const Code right_code = {parent->code.value | (1u << (parent->code.length)),
                     parent->code.length + 1};
                 parent->right->code = right_code;
                 self_ref(parent->right.get(), self_ref);
@@ -175,10 +473,87 @@ namespace tik
         };
 
         update(nodes.front().second.get(), update);
-        return CodeTree(std::move(nodes.front().second));
+
+        CodeTree tree(std::move(nodes.front().second));
+
+        if (type == CodeType::CANONICAL)
+            return canonical(tree.lengths());
+        return tree;
 
     }
 
+    //Repeats the heap steps of build_huffman on fixed arrays, so ties are
+    //broken the same way, and keeps only the parent of every node
+    CodeTree::Lengths CodeTree::huffman_lengths(const Counts& counts, unsigned max_length)
+    {
+        //Leaves are numbered by symbol, merged nodes follow them
+        constexpr std::size_t LEAVES = std::tuple_size_v<Counts>;
+        std::array<std::pair<std::uint64_t, std::uint16_t>, LEAVES> heap;
+        std::array<std::uint16_t, 2 * LEAVES - 1> parent;
+        std::size_t size = 0;
+        for (int i = std::numeric_limits<char>::min(); i <= std::numeric_limits<char>::max(); ++i)
+        {
+            const auto symbol = static_cast<unsigned char>(static_cast<char>(i));
+            if (counts[symbol])
+                heap[size++] = {counts[symbol], symbol};
+        }
+
+        if (!size)
+            throw std::invalid_argument("Cannot build a code for empty input");
+
+        Lengths lengths{};
+        if (size == 1)
+        {
+            lengths[heap.front().second] = 1;
+            return lengths;
+        }
+
+        auto cmp = [](const auto& lhs, const auto& rhs)
+        {
+            return lhs.first > rhs.first;
+        };
+
+        const auto begin = heap.begin();
+        std::ranges::make_heap(begin, begin + size, cmp);
+        std::uint16_t next = LEAVES;
+        while (size >= 2)
+        {
+            std::ranges::pop_heap(begin, begin + size, cmp);
+            std::ranges::pop_heap(begin, begin + size - 1, cmp);
+            const auto [lhs_count, lhs] = heap[size - 1];
+            const auto [rhs_count, rhs] = heap[size - 2];
+            parent[lhs] = next;
+            parent[rhs] = next;
+
+            heap[size - 2] = {lhs_count + rhs_count, next++};
+            --size;
+            std::ranges::push_heap(begin, begin + size, cmp);
+        }
+
+        //Parents are numbered after their children, so a walk down from the
+        //root sees every parent first
+        std::array<unsigned, 2 * LEAVES - 1> depth;
+        const unsigned root = next - 1;
+        depth[root] = 0;
+        unsigned longest = 0;
+        for (unsigned node = root; node-- > 0;)
+        {
+            if (node < LEAVES && !counts[node])
+                continue;
+            depth[node] = depth[parent[node]] + 1;
+            if (node < LEAVES)
+            {
+                lengths[node] = static_cast<std::uint8_t>(depth[node]);
+                longest = std::max(longest, depth[node]);
+            }
+        }
+
+        const unsigned limit = max_length ? max_length : MAX_CANONICAL_LENGTH;
+        if (longest > limit)
+            return length_limited(counts, limit);
+        return lengths;
+    }
+
     CodeTree::CodeTree(std::unique_ptr<Node> root)
         : m_root(std::move(root))
     {
@@ -270,18 +645,61 @@ namespace tik
         return result;
     }
 
+    namespace
+    {
+        //Input bytes encoded between writes of the output buffer
+        constexpr std::size_t ENCODE_PIECE = 1 << 14;
+
+        void encode_piece(std::span<const char> in, const TableEncoder& encoder,
+                          utils::BufferBitWriter& writer, std::span<const char> buffer,
+                          std::ostream& out)
+        {
+            encoder.encode(in, writer);
+            out.write(buffer.data(), writer.size());
+            writer.rewind();
+        }
+    }
+
     void CodeTree::encode(std::istream& in, std::ostream& out)
     {
-        utils::BitWriter encoder(out);
-        char c;
-        while(in.get(c))
+        const TableEncoder encoder(m_char_code);
+        std::vector<char> input(ENCODE_PIECE);
+        std::vector<char> buffer(encoder.max_encoded_size(ENCODE_PIECE));
+        utils::BufferBitWriter writer(buffer);
+        while (in.read(input.data(), input.size()) || in.gcount())
         {
-            const auto code = map_char(c);
-            encoder.write(code.value, code.length);
+            encode_piece(std::span(input.data(), in.gcount()), encoder, writer, buffer, out);
         }
+        writer.finish();
+        out.write(buffer.data(), writer.size());
+    }
+
+    void CodeTree::encode(std::span<const char> in, std::ostream& out)
+    {
+        const TableEncoder encoder(m_char_code);
+        std::vector<char> buffer(encoder.max_encoded_size(ENCODE_PIECE));
+        utils::BufferBitWriter writer(buffer);
+        for (std::size_t offset = 0; offset < in.size(); offset += ENCODE_PIECE)
+        {
+            encode_piece(in.subspan(offset, std::min(ENCODE_PIECE, in.size() - offset)),
+                         encoder, writer, buffer, out);
+        }
+        writer.finish();
+        out.write(buffer.data(), writer.size());
     }
 
     void CodeTree::decode(std::istream& in, std::ostream& out, std::uintmax_t num_chars)
+    {
+        if (!TableDecoder::supports(m_char_code))
+        {
+            decode_tree_walk(in, out, num_chars);
+            return;
+        }
+
+        TableDecoder(m_char_code).decode(in, out, num_chars);
+    }
+
+    void CodeTree::decode_tree_walk(std::istream& in, std::ostream& out, std::uintmax_t num_chars)
     {
         CodeTree::Decoder decoder(*this, in, num_chars);
         while(decoder)
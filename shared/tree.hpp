@@ -1,5 +1,8 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -12,11 +15,54 @@ namespace tik
     class CodeTree
     {
     public:
+        enum class CodeType
+        {
+            ARBITRARY,
+            //Codes are derived from code lengths only, so the lengths are
+            //all that has to be stored
+            CANONICAL
+        };
+
+        //Code length of every byte value, 0 - not present
+        using Lengths = std::array<std::uint8_t, 256>;
+        //Occurrences of every byte value
+        using Counts = std::array<std::uint64_t, 256>;
+
         static void serialize(const CodeTree& tree, std::ostream& out);
         static CodeTree deserialize(std::istream& in);
 
-        static CodeTree build_shannon_fano(std::istream& in);
-        static CodeTree build_huffman(std::istream& in);
+        //Bytes written by serialize_lengths at most
+        static constexpr std::size_t MAX_LENGTHS_SIZE = 256;
+
+        static void serialize_lengths(const Lengths& lengths, std::ostream& out);
+        //Returns the bytes written, out holds at least MAX_LENGTHS_SIZE bytes
+        static std::size_t serialize_lengths(const Lengths& lengths, std::span<char> out);
+        static Lengths deserialize_lengths(std::istream& in);
+        //used is set to the number of bytes taken from in
+        static Lengths deserialize_lengths(std::span<const char> in, std::size_t& used);
+
+        static Counts count(std::istream& in);
+        static Counts count(std::span<const char> in);
+
+        static CodeTree build_shannon_fano(std::istream& in,
+                                           CodeType type = CodeType::ARBITRARY);
+        static CodeTree build_shannon_fano(const Counts& counts,
+                                           CodeType type = CodeType::ARBITRARY);
+        //Trees deeper than max_length are replaced by optimal length
+        //limited canonical codes, 0 - no limit below MAX_CANONICAL_LENGTH,
+        //the longest code a Code holds
+        static CodeTree build_huffman(std::istream& in,
+                                      CodeType type = CodeType::ARBITRARY,
+                                      unsigned max_length = 0);
+        static CodeTree build_huffman(const Counts& counts,
+                                      CodeType type = CodeType::ARBITRARY,
+                                      unsigned max_length = 0);
+        //Code lengths of build_huffman without building the tree, nothing
+        //is allocated unless the code has to be length limited
+        static Lengths huffman_lengths(const Counts& counts, unsigned max_length = 0);
+
+        //Optimal code lengths not exceeding max_length (package-merge)
+        static Lengths length_limited(const Counts& counts, unsigned max_length);
 
         struct Code
         {
@@ -34,10 +80,21 @@ namespace tik
             }
         };
 
+        static constexpr unsigned MAX_CANONICAL_LENGTH = 32;
+
+        static std::array<Code, 256> canonical_codes(const Lengths& lengths);
+        static CodeTree canonical(const Lengths& lengths);
+
+        Lengths lengths() const;
+
         const Code& map_char(char c) const { return m_char_code.at(c); }
+        const std::unordered_map<char, Code>& codes() const { return m_char_code; }
 
         void encode(std::istream& in, std::ostream& out);
+        void encode(std::span<const char> in, std::ostream& out);
         void decode(std::istream& in, std::ostream& out, std::uintmax_t num_chars);
+        //Reference decoder walking the tree one bit at a time
+        void decode_tree_walk(std::istream& in, std::ostream& out, std::uintmax_t num_chars);
 
         bool operator==(const CodeTree& rhs) const
         {
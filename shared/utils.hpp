@@ -4,6 +4,7 @@
 #include <iostream>
 #include <bitset>
 #include <climits>
+#include <span>
 
 namespace tik
 {
@@ -46,6 +47,17 @@ namespace tik
             return result;
         }
 
+        //Byte buffers of the span API as the char buffers codecs work on
+        inline std::span<const char> as_chars(std::span<const std::byte> bytes)
+        {
+            return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+        }
+
+        inline std::span<char> as_writable_chars(std::span<std::byte> bytes)
+        {
+            return {reinterpret_cast<char*>(bytes.data()), bytes.size()};
+        }
+
         template <typename T>
         T swap_endian(T u)
         {
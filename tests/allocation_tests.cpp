@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <vector>
+#include "crc.hpp"
+#include "hamming.hpp"
+#include "tik.hpp"
+#include "test_utils.hpp"
+
+using namespace tik;
+using namespace tik::test;
+
+namespace
+{
+    //Heap allocations of the whole test binary, on every thread
+    std::atomic<std::size_t> allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+//Buffer codecs keep their tables and the caller keeps the buffers, so a
+//second round over the same inputs never touches the heap
+TEST(Allocation, BufferCodecsReuseTheirStorage)
+{
+    const auto data = random_bytes(100000, 41);
+    const auto input = std::as_bytes(std::span(data));
+
+    FseCompressor fse_compressor(30000);
+    FseDecompressor fse_decompressor;
+    HuffmanCompressor huffman_compressor;
+    HuffmanCompressor chunked_compressor(30000);
+    HuffmanDecompressor huffman_decompressor;
+    crc::Options crc_options;
+    crc_options.block_size = 512;
+
+    std::vector<std::byte> fse(fse_compressor.max_compressed_size(data.size()));
+    std::vector<std::byte> huffman(huffman_compressor.max_compressed_size(data.size()));
+    std::vector<std::byte> chunked(chunked_compressor.max_compressed_size(data.size()));
+    std::vector<std::byte> hamming(hamming::encoded_size(hamming::Type::EXTENDED, data.size()));
+    std::vector<std::byte> secded(hamming::encoded_size(hamming::Type::SECDED_72_64, data.size()));
+    std::vector<std::byte> crc(crc::HEADER_SIZE
+                               + crc::encoded_size(data.size(), {crc_options.model, crc_options.block_size}));
+    //Padding of the last Hamming codeword decodes to a few extra bytes
+    hamming::encode(input, hamming, hamming::Type::EXTENDED);
+    std::vector<std::byte> decoded(hamming::decoded_size(hamming));
+
+    //Counts the decoded bytes that differ from the input
+    std::size_t mismatches = 0;
+    const auto check = [&](std::size_t size)
+    {
+        mismatches += size != data.size() || !std::ranges::equal(std::span(decoded).first(data.size()), input);
+    };
+
+    const auto round = [&]()
+    {
+        const auto fse_size = fse_compressor.compress(input, fse);
+        check(fse_decompressor.decompress(std::span(fse).first(fse_size), decoded));
+
+        const auto huffman_size = huffman_compressor.compress(input, huffman);
+        check(huffman_decompressor.decompress(std::span(huffman).first(huffman_size), decoded));
+        const auto chunked_size = chunked_compressor.compress(input, chunked);
+        check(huffman_decompressor.decompress(std::span(chunked).first(chunked_size), decoded));
+
+        hamming::encode(input, hamming, hamming::Type::EXTENDED);
+        check(std::min(hamming::decode(hamming, decoded).size, data.size()));
+        hamming::encode(input, secded, hamming::Type::SECDED_72_64);
+        check(hamming::decode(secded, decoded).size);
+
+        crc::encode(input, crc, crc_options);
+        check(data.size() + crc::decode(crc, decoded).failed);
+    };
+
+    //The first round grows the tables, which also shows the counter works
+    std::size_t before = allocations;
+    round();
+    const std::size_t first_round = allocations - before;
+    before = allocations;
+    round();
+    const std::size_t second_round = allocations - before;
+
+    EXPECT_GT(first_round, 0u);
+    EXPECT_EQ(second_round, 0u);
+    EXPECT_EQ(mismatches, 0u);
+}
@@ -0,0 +1,304 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "crc.hpp"
+#include "test_utils.hpp"
+
+using namespace tik;
+using namespace tik::test;
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    class CrcFiles : public TempDirectory
+    {
+    };
+
+    template <const auto& poly, const crc::Model& model>
+    void expect_engines_match_bitset()
+    {
+        for (std::size_t size : {0, 1, 2, 3, 7, 8, 15, 16, 17, 33, 63, 64, 65, 100, 127, 128, 200, 1022, 1024})
+        {
+            auto data = random_bytes(size, static_cast<std::uint32_t>(size) + 1);
+            const auto expected = crc::encode_span<poly>(std::span(data)).to_ullong();
+            EXPECT_EQ((crc::encode_span_sliced<model, 8>(data)), expected) << size;
+            EXPECT_EQ((crc::encode_span_sliced<model, 16>(data)), expected) << size;
+            EXPECT_EQ(crc::encode_span_fast<model>(data), expected) << size;
+        }
+    }
+
+    template <const crc::Model& model>
+    void expect_catalogue_check(std::uint64_t expected)
+    {
+        const std::string input = "123456789";
+        EXPECT_EQ((crc::encode_span_sliced<model, 16>(input)), expected) << model.name;
+        EXPECT_EQ((crc::encode_span_sliced<model, 8>(input)), expected) << model.name;
+
+        //Long enough for the hardware paths
+        const auto data = random_bytes(1000, 3);
+        const std::span<const char> span(data);
+        const auto sliced = crc::encode_span_sliced<model>(span);
+        EXPECT_EQ(crc::encode_span_fast<model>(span), sliced) << model.name;
+        EXPECT_EQ(crc::combine<model>(crc::encode_span_fast<model>(span.first(300)),
+                                      crc::encode_span_fast<model>(span.subspan(300)), 700),
+                  sliced) << model.name;
+    }
+}
+
+TEST(Crc, EnginesMatchBitset)
+{
+    expect_engines_match_bitset<crc::CRC_16_ANSI, crc::TIK_16>();
+    expect_engines_match_bitset<crc::CRC_32, crc::TIK_32>();
+    expect_engines_match_bitset<crc::CRC_32C, crc::TIK_32C>();
+}
+
+TEST(Crc, CatalogueCheckValues)
+{
+    expect_catalogue_check<crc::CRC_16_ARC>(0xBB3D);
+    expect_catalogue_check<crc::CRC_16_IBM_3740>(0x29B1);
+    expect_catalogue_check<crc::CRC_32_ISO_HDLC>(0xCBF43926);
+    expect_catalogue_check<crc::CRC_32_ISCSI>(0xE3069283);
+    expect_catalogue_check<crc::CRC_64_XZ>(0x995DC9BBDF1939FA);
+}
+
+TEST(Crc, SlicedUpdateIsIncremental)
+{
+    const auto data = random_bytes(1000, 5);
+    const std::span<const char> span(data);
+    const auto whole = crc::encode_span_sliced<crc::TIK_32>(span);
+    const auto first = crc::encode_span_sliced<crc::TIK_32>(span.first(333));
+    EXPECT_EQ(crc::update_sliced<crc::TIK_32>(first, span.subspan(333)), whole);
+    EXPECT_EQ(crc::update<crc::TIK_32>(first, span.subspan(333)), whole);
+    EXPECT_EQ(crc::update<crc::TIK_16>(crc::encode_span_fast<crc::TIK_16>(span.first(100)),
+                                            span.subspan(100)),
+              crc::encode_span_fast<crc::TIK_16>(span));
+}
+
+TEST(Crc, Combine)
+{
+    const auto data = random_bytes(5000, 9);
+    const std::span<const char> span(data);
+    for (const std::size_t split : {0, 1, 1000, 4999, 5000})
+    {
+        const auto a = crc::encode_span_fast<crc::TIK_32>(span.first(split));
+        const auto b = crc::encode_span_fast<crc::TIK_32>(span.subspan(split));
+        EXPECT_EQ(crc::combine<crc::TIK_32>(a, b, data.size() - split),
+                  crc::encode_span_fast<crc::TIK_32>(span));
+    }
+}
+
+TEST_F(CrcFiles, ParallelEncodeAndCheck)
+{
+    //Several tasks and a partial last block
+    const auto data = random_bytes(crc::TASK_BLOCKS * crc::BLOCK_SIZE * 3 + 777, 11);
+    write(dir / "input", data);
+
+    auto expect_round_trip = [&](const crc::Options& options, std::uint64_t expected)
+    {
+        crc::Options parallel_options = options;
+        parallel_options.threads = 3;
+        EXPECT_EQ(crc::encode(dir / "input", dir / "single", options), expected);
+        EXPECT_EQ(crc::encode(dir / "input", dir / "parallel", parallel_options), expected);
+        std::ifstream single(dir / "single", std::ios::binary);
+        std::ifstream parallel(dir / "parallel", std::ios::binary);
+        EXPECT_TRUE(std::equal(std::istreambuf_iterator<char>(single), {},
+                               std::istreambuf_iterator<char>(parallel), {}));
+
+        std::ostringstream single_log;
+        std::ostringstream parallel_log;
+        EXPECT_EQ(crc::check(dir / "single", single_log), expected);
+        EXPECT_EQ(crc::check(dir / "single", parallel_log, 3), expected);
+        EXPECT_EQ(single_log.str(), parallel_log.str());
+        EXPECT_EQ(single_log.str().find("failed"), std::string::npos);
+    };
+
+    expect_round_trip(crc::Options(), crc::encode_span_fast<crc::TIK_16>(data));
+    crc::Options options;
+    options.model = *crc::find_model("crc-32/iso-hdlc");
+    options.block_size = 1 << 16;
+    expect_round_trip(options, crc::encode_span_fast<crc::CRC_32_ISO_HDLC>(data));
+}
+
+TEST(Crc, LocatesBitErrors)
+{
+    const crc::ErrorLocator<crc::CRC_32_ISO_HDLC> locator(crc::BLOCK_SIZE);
+    auto block = random_bytes(crc::BLOCK_SIZE, 13);
+    const auto payload = std::span(block).first(crc::BLOCK_SIZE - 4);
+    const auto crc = crc::encode_span_fast<crc::CRC_32_ISO_HDLC>(payload);
+    for (std::size_t i = 0; i < 4; i++)
+        block[payload.size() + i] = static_cast<char>(crc >> ((3 - i) * 8));
+
+    auto syndrome = [&](std::initializer_list<std::size_t> bits)
+    {
+        auto damaged = block;
+        for (const auto bit : bits)
+            damaged[bit / 8] ^= static_cast<char>(1 << (bit % 8));
+        std::uint32_t stored = 0;
+        for (std::size_t i = payload.size(); i < damaged.size(); i++)
+            stored = stored << 8 | static_cast<unsigned char>(damaged[i]);
+        return crc::encode_span_fast<crc::CRC_32_ISO_HDLC>(std::span(damaged).first(payload.size())) ^ stored;
+    };
+
+    //Payload bits and bits of the stored crc
+    for (const std::size_t bit : {0, 7, 8, 4000, 8159, 8160, 8191})
+    {
+        const auto distance = locator.locate(syndrome({bit}));
+        ASSERT_TRUE(distance) << bit;
+        EXPECT_EQ(crc::block_bit(crc::BLOCK_SIZE, *distance), bit);
+    }
+
+    ASSERT_TRUE(locator.pairs());
+    const auto pair = locator.locate_pair(syndrome({100, 5000}), crc::BLOCK_SIZE);
+    ASSERT_TRUE(pair);
+    EXPECT_EQ(crc::block_bit(crc::BLOCK_SIZE, pair->first), 5000u);
+    EXPECT_EQ(crc::block_bit(crc::BLOCK_SIZE, pair->second), 100u);
+    EXPECT_FALSE(locator.locate(0));
+}
+
+TEST(Crc, LocatorRejectsAmbiguousSyndromes)
+{
+    //Syndromes of tik-16 repeat every 11811 bits, so a 2 KiB block has
+    //bits that can not be told apart
+    constexpr std::size_t PERIOD = 11811;
+    const crc::ErrorLocator<crc::TIK_16> short_block(crc::BLOCK_SIZE);
+    const crc::ErrorLocator<crc::TIK_16> long_block(2048);
+    for (const std::size_t distance : {16, 100, 4000})
+    {
+        EXPECT_EQ(short_block.locate(short_block.syndrome(distance)), distance);
+        EXPECT_EQ(long_block.syndrome(distance), long_block.syndrome(distance + PERIOD));
+        EXPECT_FALSE(long_block.locate(long_block.syndrome(distance))) << distance;
+    }
+
+    using Locator = crc::ErrorLocator<crc::TIK_16>;
+    EXPECT_THROW(Locator(Locator::MAX_BLOCK_SIZE + 1), std::invalid_argument);
+}
+
+TEST_F(CrcFiles, DecodeVerifiesAndRepairs)
+{
+    const auto data = random_bytes(crc::TASK_BLOCKS * crc::BLOCK_SIZE + 500, 17);
+    write(dir / "input", data);
+    crc::Options encode_options;
+    encode_options.model = *crc::find_model("crc-32/iscsi");
+    const auto expected = crc::encode(dir / "input", dir / "encoded", encode_options);
+
+    //One payload bit, one stored crc bit and a double error
+    auto encoded = read(dir / "encoded");
+    encoded[crc::HEADER_SIZE + 10] ^= 0x04;
+    encoded[crc::HEADER_SIZE + 2 * crc::BLOCK_SIZE - 1] ^= 0x80;
+    encoded[crc::HEADER_SIZE + 5 * crc::BLOCK_SIZE + 1] ^= 0x03;
+    write(dir / "damaged", encoded);
+
+    std::ostringstream log;
+    const auto clean = crc::decode(dir / "encoded", dir / "clean", log);
+    EXPECT_EQ(clean.crc, expected);
+    EXPECT_EQ(clean.failed, 0u);
+    EXPECT_EQ(read(dir / "clean"), data);
+
+    crc::DecodeOptions options;
+    options.threads = 2;
+    const auto reported = crc::decode(dir / "damaged", dir / "reported", log, options);
+    EXPECT_EQ(reported.failed, 3u);
+    EXPECT_EQ(reported.repaired, 0u);
+
+    options.repair = true;
+    const auto repaired = crc::decode(dir / "damaged", dir / "repaired", log, options);
+    EXPECT_EQ(repaired.failed, 1u);
+    EXPECT_EQ(repaired.repaired, 2u);
+    auto restored = read(dir / "repaired");
+    EXPECT_NE(restored, data);
+    restored[5 * (crc::BLOCK_SIZE - 4) + 1] ^= 0x03;
+    EXPECT_EQ(restored, data);
+
+    options.abort = true;
+    EXPECT_THROW(crc::decode(dir / "damaged", dir / "aborted", log, options), std::runtime_error);
+    EXPECT_FALSE(fs::exists(dir / "aborted"));
+}
+
+TEST(Crc, SpanMatchesStreamFormat)
+{
+    crc::Options options;
+    options.model = *crc::find_model("crc-32/iscsi");
+    options.block_size = 512;
+    const crc::Header header{options.model, options.block_size};
+
+    std::vector<std::byte> encoded;
+    std::vector<std::byte> decoded;
+    for (const std::size_t size : {0, 1, 508, 509, 100000})
+    {
+        const auto data = random_bytes(size, 29);
+        std::istringstream in(std::string(data.begin(), data.end()));
+        std::ostringstream out;
+        const auto expected = crc::encode(in, out, options);
+
+        encoded.resize(crc::HEADER_SIZE + crc::encoded_size(size, header));
+        EXPECT_EQ(crc::encode(std::as_bytes(std::span(data)), encoded, options), expected);
+        const std::string expected_encoded = out.str();
+        EXPECT_TRUE(std::ranges::equal(encoded, std::as_bytes(std::span(expected_encoded)))) << size;
+
+        decoded.resize(crc::decoded_size(encoded));
+        const auto clean = crc::decode(encoded, decoded);
+        EXPECT_EQ(clean.crc, expected);
+        EXPECT_EQ(clean.failed, 0u);
+        EXPECT_TRUE(std::ranges::equal(decoded, std::as_bytes(std::span(data)))) << size;
+
+        if (size)
+        {
+            encoded[crc::HEADER_SIZE] ^= std::byte{1};
+            EXPECT_EQ(crc::decode(encoded, decoded).failed, 1u);
+        }
+    }
+}
+
+TEST(Crc, RepairRefusesBlocksLongerThanThePeriod)
+{
+    //Every bit of a 64 KiB tik-16 block shares its syndrome with others
+    constexpr std::size_t block_size = 65536;
+    const auto data = random_bytes(block_size * 2, 31);
+    std::ostringstream encoded_stream;
+    crc::encode<crc::TIK_16>(data, encoded_stream, block_size);
+    std::string encoded = encoded_stream.str();
+    encoded[1000] ^= 0x10;
+
+    crc::DecodeOptions options;
+    options.repair = true;
+    std::ostringstream decoded;
+    std::ostringstream log;
+    const auto result = crc::decode<crc::TIK_16>(encoded, decoded, log, block_size, options);
+    EXPECT_EQ(result.failed, 1u);
+    EXPECT_EQ(result.repaired, 0u);
+    EXPECT_EQ(log.str().find("repaired"), std::string::npos);
+}
+
+TEST_F(CrcFiles, UpdateRewritesChangedBlocks)
+{
+    crc::Options options;
+    options.model = *crc::find_model("crc-16/arc");
+    options.block_size = 512;
+    const std::size_t payload_size = options.block_size - 2;
+
+    auto data = random_bytes(payload_size * 20 + 100, 19);
+    write(dir / "input", data);
+    crc::encode(dir / "input", dir / "input.crc", options);
+
+    //A patch inside one block and an append to the partial last block
+    data[payload_size * 3 + 7] ^= 1;
+    const auto tail = random_bytes(payload_size + 50, 23);
+    data.insert(data.end(), tail.begin(), tail.end());
+    write(dir / "input", data);
+    const std::array ranges{crc::Range{payload_size * 3 + 7, 1}};
+    EXPECT_EQ(crc::update(dir / "input", dir / "input.crc", ranges), 3u);
+    crc::encode(dir / "input", dir / "expected", options);
+    EXPECT_EQ(read(dir / "input.crc"), read(dir / "expected"));
+
+    //Without ranges the payload is compared, a shorter input truncates
+    data[10] ^= 1;
+    data.resize(payload_size * 5 + 1);
+    write(dir / "input", data);
+    EXPECT_EQ(crc::update(dir / "input", dir / "input.crc"), 2u);
+    crc::encode(dir / "input", dir / "expected", options);
+    EXPECT_EQ(read(dir / "input.crc"), read(dir / "expected"));
+}
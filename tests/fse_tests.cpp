@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <bit>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "fse.hpp"
+#include "table_encoder.hpp"
+
+using namespace tik;
+
+namespace
+{
+    std::string skewed_input(std::size_t size)
+    {
+        std::string input;
+        input.reserve(size);
+        std::uint32_t state = 12345;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            state = state * 1664525 + 1013904223;
+            input.push_back(static_cast<char>(std::countr_zero(state | 0x80000000u) * 7 + (state >> 29)));
+        }
+        return input;
+    }
+
+    //Returns the encoded size in bytes
+    std::size_t expect_round_trip(const std::string& input)
+    {
+        const auto normalized = FseCoder::normalize(CodeTree::count(input));
+        EXPECT_EQ(std::accumulate(normalized.begin(), normalized.end(), 0u),
+                  1u << FseCoder::DEFAULT_TABLE_LOG);
+
+        std::ostringstream header;
+        FseCoder::serialize(normalized, FseCoder::DEFAULT_TABLE_LOG, header);
+        unsigned table_log;
+        std::size_t used;
+        EXPECT_EQ(FseCoder::deserialize(header.str(), table_log, used), normalized);
+        EXPECT_EQ(used, header.str().size());
+        EXPECT_EQ(table_log, FseCoder::DEFAULT_TABLE_LOG);
+
+        const FseCoder coder(normalized, table_log);
+        std::vector<char> buffer(coder.max_encoded_size(input.size()));
+        utils::BufferBitWriter writer(buffer);
+        coder.encode(input, writer);
+        const std::uint64_t bits = writer.bits_written();
+        const std::size_t size = writer.finish();
+
+        std::string decoded(input.size(), '\0');
+        EXPECT_EQ(coder.decode(std::span<const char>(buffer).first(size), decoded), bits);
+        EXPECT_EQ(decoded, input);
+        return size;
+    }
+}
+
+TEST(Fse, RoundTrip)
+{
+    expect_round_trip("AAAAABAAAABAAABBBCBBCCCACCDDDADDDEEEEAE");
+    expect_round_trip(skewed_input(100000));
+    expect_round_trip(std::string(1000, 'Z'));
+    expect_round_trip("x");
+
+    std::string all;
+    for (unsigned i = 0; i < 256 * 4; ++i)
+        all.push_back(static_cast<char>(i));
+    expect_round_trip(all);
+}
+
+TEST(Fse, BeatsHuffmanOnSkewedInput)
+{
+    //Mostly one symbol: Huffman can not go below one bit per symbol
+    std::string input = skewed_input(100000);
+    for (std::size_t i = 0; i < input.size(); ++i)
+    {
+        if (i % 20)
+            input[i] = 'a';
+    }
+
+    const auto counts = CodeTree::count(input);
+    const TableEncoder huffman(CodeTree::build_huffman(counts).codes());
+    EXPECT_LT(expect_round_trip(input) * 8, huffman.encoded_bits(counts) / 2);
+}
+
+TEST(Fse, DetectsCorruption)
+{
+    const std::string input = skewed_input(10000);
+    const auto normalized = FseCoder::normalize(CodeTree::count(input));
+    const FseCoder coder(normalized, FseCoder::DEFAULT_TABLE_LOG);
+
+    std::vector<char> buffer(coder.max_encoded_size(input.size()));
+    utils::BufferBitWriter writer(buffer);
+    coder.encode(input, writer);
+    buffer.resize(writer.finish());
+    buffer[buffer.size() / 2] ^= 0x10;
+
+    std::string decoded(input.size(), '\0');
+    EXPECT_THROW(coder.decode(buffer, decoded), std::invalid_argument);
+
+    std::vector<char> unused(64);
+    utils::BufferBitWriter unused_writer(unused);
+    EXPECT_THROW(coder.encode("\xff", unused_writer), std::out_of_range);
+}
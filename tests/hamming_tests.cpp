@@ -0,0 +1,332 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <bitset>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "bit_getter.hpp"
+#include "hamming.hpp"
+#include "hamming_screen.hpp"
+#include "test_utils.hpp"
+
+using namespace tik;
+using namespace tik::test;
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    //The format pads the last codeword with ones, which may decode to an
+    //extra 0xFF byte
+    void expect_decoded(const std::vector<char>& decoded, const std::vector<char>& data)
+    {
+        ASSERT_GE(decoded.size(), data.size());
+        ASSERT_LE(decoded.size(), data.size() + 1);
+        EXPECT_TRUE(std::equal(data.begin(), data.end(), decoded.begin()));
+        if (decoded.size() > data.size())
+        {
+            EXPECT_EQ(decoded.back(), '\xFF');
+        }
+    }
+
+    //Bitset encoder of the first version, kept to pin the codeword layout
+    //of the (15, 11) and (16, 11) codes
+    std::vector<char> reference_encode(const std::vector<char>& data, hamming::Type type)
+    {
+        std::istringstream input(std::string(data.begin(), data.end()));
+        std::ostringstream output;
+        output.put(char(type));
+
+        utils::BitGetter bit_getter(input);
+        while (bit_getter)
+        {
+            std::bitset<4> code;
+            std::bitset<16> out;
+
+            for (unsigned i = 0; i < 11; ++i)
+            {
+                if (bit_getter.get())
+                {
+                    unsigned mapped;
+                    if (i == 0)
+                        mapped = 3;
+                    else if (i < 4)
+                        mapped = i + 4;
+                    else
+                        mapped = i + 5;
+
+                    out[mapped] = true;
+                    code ^= mapped;
+                }
+            }
+            out[1] = code[0];
+            out[2] = code[1];
+            out[4] = code[2];
+            out[8] = code[3];
+
+            if (type == hamming::Type::EXTENDED)
+                out[0] = out.count() % 2;
+            std::uint16_t o = out.to_ulong();
+            output.write(reinterpret_cast<const char*>(&o), sizeof(o));
+        }
+
+        const std::string result = std::move(output).str();
+        return std::vector<char>(result.begin(), result.end());
+    }
+
+    class Hamming : public TempDirectory
+    {
+    };
+}
+
+TEST_F(Hamming, RoundTrip)
+{
+    //Whole 11 byte groups, a partial group and sizes below one group
+    for (const std::size_t size : {1, 10, 11, 12, 1000, 11 * 6144 + 5})
+    {
+        const auto data = random_bytes(size, static_cast<std::uint32_t>(size));
+        write(dir / "input", data);
+
+        hamming::encode(dir / "input", dir / "encoded");
+        EXPECT_EQ(fs::file_size(dir / "encoded"), 1 + 2 * (size * 8 / 11 + 1)) << size;
+        hamming::decode(dir / "encoded", dir / "decoded");
+        expect_decoded(read(dir / "decoded"), data);
+
+        hamming::encode_not_extended(dir / "input", dir / "encoded");
+        hamming::decode(dir / "encoded", dir / "decoded");
+        expect_decoded(read(dir / "decoded"), data);
+    }
+}
+
+TEST_F(Hamming, MatchesReferenceEncoder)
+{
+    std::vector<std::byte> encoded;
+    for (const auto type : {hamming::Type::NORMAL, hamming::Type::EXTENDED})
+    {
+        for (const std::size_t size : {0, 1, 10, 11, 12, 1000, 11 * 6144 * 3 + 5})
+        {
+            const auto data = random_bytes(size, static_cast<std::uint32_t>(size) + 3);
+            const auto expected = reference_encode(data, type);
+            write(dir / "input", data);
+
+            if (type == hamming::Type::EXTENDED)
+                hamming::encode(dir / "input", dir / "encoded");
+            else
+                hamming::encode_not_extended(dir / "input", dir / "encoded");
+            EXPECT_EQ(read(dir / "encoded"), expected) << size;
+
+            hamming::encode(dir / "input", dir / "encoded", type, 3);
+            EXPECT_EQ(read(dir / "encoded"), expected) << size;
+
+            encoded.resize(hamming::encoded_size(type, size));
+            hamming::encode(std::as_bytes(std::span(data)), encoded, type);
+            EXPECT_TRUE(std::ranges::equal(encoded, std::as_bytes(std::span(expected)))) << size;
+        }
+    }
+}
+
+TEST_F(Hamming, CorrectsSingleErrors)
+{
+    const auto data = random_bytes(5000, 7);
+    write(dir / "input", data);
+    hamming::encode(dir / "input", dir / "encoded");
+
+    //One flipped bit in a few codewords, the rest stay clean
+    auto encoded = read(dir / "encoded");
+    for (const std::size_t codeword : {0, 1, 100, 1001, 3000})
+        encoded[1 + codeword * 2 + codeword % 2] ^= static_cast<char>(1 << (codeword % 8));
+    write(dir / "damaged", encoded);
+
+    hamming::decode(dir / "damaged", dir / "decoded");
+    expect_decoded(read(dir / "decoded"), data);
+
+    std::ostringstream log;
+    hamming::check(dir / "damaged", log);
+    EXPECT_EQ(log.str().find("Double"), std::string::npos);
+    EXPECT_NE(log.str().find("Single error at codeword 1002 bit 9 "), std::string::npos);
+}
+
+TEST_F(Hamming, SecdedRoundTrip)
+{
+    for (const auto type : {hamming::Type::SECDED_39_32, hamming::Type::SECDED_72_64})
+    {
+        const std::size_t word = type == hamming::Type::SECDED_39_32 ? 4 : 8;
+        for (const std::size_t size : {0, 1, 7, 8, 9, 1000, 65536 + 3})
+        {
+            const auto data = random_bytes(size, static_cast<std::uint32_t>(size));
+            write(dir / "input", data);
+
+            hamming::encode(dir / "input", dir / "encoded", type);
+            const std::size_t words = (8 + size + word - 1) / word;
+            EXPECT_EQ(fs::file_size(dir / "encoded"), 1 + words * (word + 1)) << size;
+            hamming::decode(dir / "encoded", dir / "decoded");
+            EXPECT_EQ(read(dir / "decoded"), data) << size;
+        }
+    }
+}
+
+TEST_F(Hamming, SpanMatchesFileFormat)
+{
+    std::vector<std::byte> encoded;
+    std::vector<std::byte> decoded;
+    for (const auto type : {hamming::Type::NORMAL, hamming::Type::EXTENDED,
+                            hamming::Type::SECDED_39_32, hamming::Type::SECDED_72_64})
+    {
+        for (const std::size_t size : {0, 1, 11, 1000, 11 * 6144 + 5})
+        {
+            const auto data = random_bytes(size, static_cast<std::uint32_t>(size));
+            write(dir / "input", data);
+            hamming::encode(dir / "input", dir / "encoded", type);
+            hamming::decode(dir / "encoded", dir / "decoded");
+
+            const auto expected_encoded = read(dir / "encoded");
+            const auto expected_decoded = read(dir / "decoded");
+
+            encoded.resize(hamming::encoded_size(type, size));
+            ASSERT_EQ(hamming::encode(std::as_bytes(std::span(data)), encoded, type), encoded.size());
+            EXPECT_TRUE(std::ranges::equal(encoded, std::as_bytes(std::span(expected_encoded)))) << size;
+
+            //A flip in the last codeword is corrected
+            if (size)
+                encoded.back() ^= std::byte{0x10};
+            decoded.resize(hamming::decoded_size(encoded));
+            const auto result = hamming::decode(encoded, decoded);
+            EXPECT_EQ(result.size, decoded.size());
+            EXPECT_EQ(result.double_errors, 0u);
+            EXPECT_TRUE(std::ranges::equal(decoded, std::as_bytes(std::span(expected_decoded)))) << size;
+        }
+    }
+}
+
+TEST_F(Hamming, SecdedCorrectsSingleAndDetectsDoubleErrors)
+{
+    const auto data = random_bytes(5000, 11);
+    write(dir / "input", data);
+    hamming::encode(dir / "input", dir / "encoded", hamming::Type::SECDED_72_64);
+
+    //Codeword 0 holds the size, every bit of a codeword is tried once
+    auto encoded = read(dir / "encoded");
+    for (std::size_t bit = 0; bit < 72; ++bit)
+    {
+        const std::size_t codeword = 1 + bit;
+        encoded[1 + codeword * 9 + bit / 8] ^= static_cast<char>(1 << (bit % 8));
+    }
+    write(dir / "damaged", encoded);
+
+    hamming::decode(dir / "damaged", dir / "decoded");
+    EXPECT_EQ(read(dir / "decoded"), data);
+
+    std::ostringstream log;
+    hamming::check(dir / "damaged", log);
+    EXPECT_EQ(log.str().find("Double"), std::string::npos);
+    EXPECT_NE(log.str().find("Hamming(72, 64)\nSingle error at codeword 2 bit 0 (72)\n"), std::string::npos);
+    EXPECT_NE(log.str().find("Single error at codeword 73 bit 71 "), std::string::npos);
+
+    //A second flip in one codeword is reported, not miscorrected
+    encoded[1 + 9 * 2] ^= 0x10;
+    write(dir / "damaged", encoded);
+    log.str("");
+    hamming::check(dir / "damaged", log);
+    EXPECT_NE(log.str().find("Double error at codeword 3\n"), std::string::npos);
+}
+
+TEST_F(Hamming, ThreadsMatchSequential)
+{
+    //Several blocks with a partial last one
+    const auto data = random_bytes(11 * 6144 * 5 + 17, 3);
+    write(dir / "input", data);
+
+    for (const auto type : {hamming::Type::EXTENDED, hamming::Type::SECDED_72_64})
+    {
+        hamming::encode(dir / "input", dir / "sequential", type);
+        hamming::encode(dir / "input", dir / "parallel", type, 4);
+        auto encoded = read(dir / "parallel");
+        EXPECT_EQ(encoded, read(dir / "sequential"));
+
+        for (std::size_t pos = 100; pos < encoded.size(); pos += 9973)
+            encoded[pos] ^= 0x04;
+        write(dir / "damaged", encoded);
+
+        std::ostringstream sequential;
+        std::ostringstream parallel;
+        hamming::check(dir / "damaged", sequential);
+        hamming::check(dir / "damaged", parallel, 4);
+        EXPECT_EQ(parallel.str(), sequential.str());
+
+        hamming::decode(dir / "damaged", dir / "decoded", 4);
+        if (type == hamming::Type::EXTENDED)
+            expect_decoded(read(dir / "decoded"), data);
+        else
+            EXPECT_EQ(read(dir / "decoded"), data);
+    }
+}
+
+TEST_F(Hamming, RepairRewritesDamagedCodewords)
+{
+    const auto data = random_bytes(20000, 5);
+    write(dir / "input", data);
+
+    for (const auto type : {hamming::Type::EXTENDED, hamming::Type::SECDED_39_32})
+    {
+        const std::size_t stored = type == hamming::Type::EXTENDED ? 2 : 5;
+        hamming::encode(dir / "input", dir / "encoded", type);
+        const auto encoded = read(dir / "encoded");
+
+        //Single flips in three codewords, the parity bit of the (16, 11)
+        //code included, and two flips in a fourth one
+        auto damaged = encoded;
+        for (const std::size_t codeword : {3, 500, 2000})
+            damaged[1 + codeword * stored] ^= static_cast<char>(1 << (codeword % 8));
+        const std::uint64_t double_offset = 1 + 3000 * stored;
+        damaged[double_offset] ^= 0x11;
+        write(dir / "damaged", damaged);
+
+        const auto result = hamming::repair(dir / "damaged");
+        EXPECT_EQ(result.repaired, 3u);
+        EXPECT_EQ(result.double_errors, std::vector<std::uint64_t>{double_offset});
+
+        //Only the double error is left
+        auto expected = encoded;
+        expected[double_offset] ^= 0x11;
+        EXPECT_EQ(read(dir / "damaged"), expected);
+    }
+}
+
+TEST_F(Hamming, LegacyTypeIsNotCorrected)
+{
+    const auto data = random_bytes(1000, 9);
+    std::vector<std::byte> encoded(hamming::encoded_size(hamming::Type::EXTENDED, data.size()));
+    hamming::encode(std::as_bytes(std::span(data)), encoded, hamming::Type::EXTENDED);
+    encoded[0] = static_cast<std::byte>(hamming::Type::LEGACY);
+
+    std::vector<std::byte> decoded(hamming::decoded_size(encoded));
+    hamming::decode(encoded, decoded);
+    EXPECT_TRUE(std::ranges::equal(std::span(decoded).first(data.size()), std::as_bytes(std::span(data))));
+
+    //The flip stays in the data and repair leaves the file alone
+    encoded[1] ^= std::byte{0x08};
+    hamming::decode(encoded, decoded);
+    EXPECT_FALSE(std::ranges::equal(std::span(decoded).first(data.size()), std::as_bytes(std::span(data))));
+
+    std::ofstream(dir / "legacy", std::ios::binary).write(reinterpret_cast<const char*>(encoded.data()),
+                                                         encoded.size());
+    EXPECT_EQ(hamming::repair(dir / "legacy").repaired, 0u);
+
+    EXPECT_THROW(hamming::encoded_size(hamming::Type::LEGACY, 10), std::invalid_argument);
+}
+
+TEST(HammingScreen, ScalarMatchesDispatch)
+{
+    std::vector<char> group(hamming::screen::GROUP * 2);
+    for (std::size_t i = 0; i <= group.size(); ++i)
+    {
+        //Zero codewords have zero syndromes, then one bit set at a time
+        std::fill(group.begin(), group.end(), '\0');
+        if (i < group.size())
+            group[i] = static_cast<char>(1 << (i % 8));
+
+        const bool expected = i == group.size() || (i % 2 == 0 && i % 8 == 0);
+        EXPECT_EQ(hamming::screen::clean_scalar(group.data()), expected) << i;
+        EXPECT_EQ(hamming::screen::clean(group.data()), expected) << i;
+    }
+}
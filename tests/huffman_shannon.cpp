@@ -1,5 +1,12 @@
 #include <gtest/gtest.h>
 #include "tree.hpp"
+#include "table_decoder.hpp"
+#include "table_encoder.hpp"
+#include "bit_writer.hpp"
+#include <bit>
+#include <cmath>
+#include <algorithm>
+#include <utility>
 
 using namespace tik;
 
@@ -65,3 +72,280 @@ TEST(Tree, SerializeDeserialize)
 
     EXPECT_TRUE(tree == deserialized_tree);
 };
+
+namespace
+{
+    //Fibonacci frequencies give the deepest possible Huffman tree
+    std::string fibonacci_input(unsigned symbols)
+    {
+        std::string input;
+        unsigned a = 1, b = 1;
+        for (unsigned i = 0; i < symbols; ++i)
+        {
+            input.append(a, static_cast<char>('a' + i));
+            unsigned next = a + b;
+            a = b;
+            b = next;
+        }
+        return input;
+    }
+
+    std::string skewed_input(std::size_t size)
+    {
+        std::string input;
+        input.reserve(size);
+        std::uint32_t state = 12345;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            state = state * 1664525 + 1013904223;
+            input.push_back(static_cast<char>(std::countr_zero(state | 0x80000000u) * 7 + (state >> 29)));
+        }
+        return input;
+    }
+
+    void expect_table_matches_tree_walk(CodeTree tree, const std::string& input)
+    {
+        std::istringstream is(input);
+        std::stringstream encoded;
+        tree.encode(is, encoded);
+
+        std::istringstream tree_in(encoded.str());
+        std::ostringstream tree_out;
+        tree.decode_tree_walk(tree_in, tree_out, input.length());
+
+        std::istringstream table_in(encoded.str());
+        std::ostringstream table_out;
+        tree.decode(table_in, table_out, input.length());
+
+        EXPECT_EQ(tree_out.str(), input);
+        EXPECT_EQ(table_out.str(), tree_out.str());
+    }
+}
+
+TEST(Tree, TableDecodeMatchesTreeWalk)
+{
+    const std::string input = skewed_input(100000);
+    {
+        std::istringstream is(input);
+        expect_table_matches_tree_walk(CodeTree::build_huffman(is), input);
+    }
+    {
+        std::istringstream is(input);
+        expect_table_matches_tree_walk(CodeTree::build_shannon_fano(is), input);
+    }
+}
+
+TEST(Tree, TableDecodeLongCodes)
+{
+    const std::string input = fibonacci_input(25);
+    std::istringstream is(input);
+    auto tree = CodeTree::build_huffman(is);
+    EXPECT_EQ(tree.map_char('a').length, 24);
+
+    expect_table_matches_tree_walk(std::move(tree), input);
+}
+
+TEST(Tree, TableDecodeSingleSymbol)
+{
+    const std::string input(1000, 'Z');
+    std::istringstream is(input);
+    expect_table_matches_tree_walk(CodeTree::build_huffman(is), input);
+}
+
+TEST(Tree, TableEncodeMatchesBitWriter)
+{
+    for (const std::string& input : {skewed_input(100000), fibonacci_input(30)})
+    {
+        std::istringstream is(input);
+        auto tree = CodeTree::build_huffman(is, CodeTree::CodeType::ARBITRARY,
+                                                  CodeTree::MAX_CANONICAL_LENGTH);
+
+        std::ostringstream expected;
+        {
+            utils::BitWriter writer(expected);
+            for (const char c : input)
+            {
+                const auto& code = tree.map_char(c);
+                writer.write(code.value, code.length);
+            }
+        }
+
+        const TableEncoder encoder(tree.codes());
+        std::vector<char> buffer(encoder.max_encoded_size(input.size()));
+        utils::BufferBitWriter writer(buffer);
+        encoder.encode(input, writer);
+        const std::size_t size = writer.finish();
+        EXPECT_EQ(std::string(buffer.data(), size), expected.str());
+
+        std::ostringstream encoded;
+        tree.encode(std::span<const char>(input), encoded);
+        EXPECT_EQ(encoded.str(), expected.str());
+    }
+}
+
+TEST(Tree, TableEncodeRejectsUnknownSymbol)
+{
+    const std::string input = "AAAAABAAAABAAABBB";
+    std::istringstream is(input);
+    const TableEncoder encoder(CodeTree::build_huffman(is).codes());
+
+    std::vector<char> buffer(64);
+    utils::BufferBitWriter writer(buffer);
+    EXPECT_THROW(encoder.encode(std::string("ABC"), writer), std::out_of_range);
+}
+
+TEST(Tree, CanonicalLengthsRoundTrip)
+{
+    const std::string input = skewed_input(10000);
+    std::istringstream is(input);
+    auto tree = CodeTree::build_huffman(is, CodeTree::CodeType::CANONICAL);
+
+    std::stringstream ss;
+    CodeTree::serialize_lengths(tree.lengths(), ss);
+    EXPECT_LT(ss.str().size(), 64);
+
+    auto deserialized = CodeTree::canonical(CodeTree::deserialize_lengths(ss));
+    EXPECT_TRUE(tree == deserialized);
+}
+
+TEST(Tree, CanonicalPreservesLengths)
+{
+    const std::string input = skewed_input(10000);
+    std::istringstream is(input);
+    auto tree = CodeTree::build_shannon_fano(is);
+    is = std::istringstream(input);
+    auto canonical = CodeTree::build_shannon_fano(is, CodeTree::CodeType::CANONICAL);
+
+    EXPECT_EQ(tree.lengths(), canonical.lengths());
+    expect_table_matches_tree_walk(std::move(canonical), input);
+}
+
+TEST(Tree, CanonicalDecodeFromLengths)
+{
+    const std::string input = fibonacci_input(20) + skewed_input(1000);
+    std::istringstream is(input);
+    auto tree = CodeTree::build_huffman(is, CodeTree::CodeType::CANONICAL);
+
+    is = std::istringstream(input);
+    std::stringstream encoded;
+    tree.encode(is, encoded);
+
+    std::ostringstream os;
+    TableDecoder(tree.lengths()).decode(encoded, os, input.length());
+    EXPECT_EQ(os.str(), input);
+}
+
+TEST(Tree, CanonicalRejectsOversubscribedLengths)
+{
+    CodeTree::Lengths lengths{};
+    lengths['a'] = 1;
+    lengths['b'] = 1;
+    lengths['c'] = 1;
+    EXPECT_THROW(CodeTree::canonical_codes(lengths), std::invalid_argument);
+}
+
+TEST(Tree, LengthLimited)
+{
+    std::array<std::uint64_t, 256> counts{};
+    std::uint64_t a = 1, b = 1;
+    for (unsigned i = 0; i < 60; ++i)
+    {
+        counts[i] = a;
+        std::uint64_t next = a + b;
+        a = b;
+        b = next;
+    }
+
+    for (unsigned max_length : {6u, 12u, 32u})
+    {
+        const auto lengths = CodeTree::length_limited(counts, max_length);
+        double kraft = 0;
+        for (unsigned i = 0; i < 60; ++i)
+        {
+            EXPECT_GE(lengths[i], 1);
+            EXPECT_LE(lengths[i], max_length);
+            kraft += std::ldexp(1.0, -lengths[i]);
+        }
+        EXPECT_DOUBLE_EQ(kraft, 1.0);
+    }
+    EXPECT_THROW(CodeTree::length_limited(counts, 5), std::invalid_argument);
+}
+
+TEST(Tree, LengthLimitedMatchesHuffmanCost)
+{
+    const std::string input = skewed_input(10000);
+    std::array<std::uint64_t, 256> counts{};
+    for (const char c : input)
+        ++counts[static_cast<unsigned char>(c)];
+
+    std::istringstream is(input);
+    const auto huffman = CodeTree::build_huffman(is).lengths();
+    const auto limited = CodeTree::length_limited(counts, 32);
+
+    std::uint64_t huffman_cost = 0, limited_cost = 0;
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        huffman_cost += counts[i] * huffman[i];
+        limited_cost += counts[i] * limited[i];
+    }
+    EXPECT_EQ(huffman_cost, limited_cost);
+}
+
+TEST(Tree, BuildHuffmanMaxLength)
+{
+    const std::string input = fibonacci_input(25);
+    std::istringstream is(input);
+    auto tree = CodeTree::build_huffman(is, CodeTree::CodeType::ARBITRARY, 12);
+
+    const auto lengths = tree.lengths();
+    EXPECT_EQ(*std::ranges::max_element(lengths), 12);
+    expect_table_matches_tree_walk(std::move(tree), input);
+}
+
+TEST(Tree, BuildHuffmanDeepTree)
+{
+    //Fibonacci counts of 50 symbols build a tree 49 levels deep
+    CodeTree::Counts counts{};
+    std::uint64_t a = 1, b = 1;
+    for (unsigned i = 0; i < 50; ++i)
+    {
+        counts[i] = a;
+        b = std::exchange(a, b) + b;
+    }
+
+    for (const unsigned max_length : {0u, 20u})
+    {
+        const auto lengths = CodeTree::build_huffman(counts, CodeTree::CodeType::ARBITRARY, max_length).lengths();
+        EXPECT_EQ(*std::ranges::max_element(lengths), max_length ? max_length : CodeTree::MAX_CANONICAL_LENGTH);
+    }
+}
+
+TEST(Tree, HuffmanLengthsMatchTree)
+{
+    //Equal counts, a lone symbol, skewed and random counts
+    std::vector<CodeTree::Counts> cases(4);
+    cases[0].fill(7);
+    cases[1]['x'] = 3;
+    std::uint64_t a = 1, b = 1;
+    for (unsigned i = 0; i < 40; ++i)
+    {
+        cases[2][i * 5] = a;
+        b = std::exchange(a, b) + b;
+    }
+    std::uint32_t state = 1;
+    for (auto& n : cases[3])
+    {
+        state = state * 1664525 + 1013904223;
+        n = (state >> 28) < 4 ? 0 : state >> 20;
+    }
+
+    for (const auto& counts : cases)
+    {
+        for (const unsigned max_length : {0u, 12u})
+        {
+            EXPECT_EQ(CodeTree::huffman_lengths(counts, max_length),
+                      CodeTree::build_huffman(counts, CodeTree::CodeType::ARBITRARY, max_length).lengths());
+        }
+    }
+    EXPECT_THROW(CodeTree::huffman_lengths(CodeTree::Counts{}), std::invalid_argument);
+}
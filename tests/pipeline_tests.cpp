@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pipeline.hpp"
+#include "spsc_ring.hpp"
+#include "test_utils.hpp"
+
+using namespace tik;
+using namespace tik::test;
+
+namespace
+{
+    //Words from a small vocabulary, so every stage has work to do
+    std::string text(std::size_t size, std::uint32_t state)
+    {
+        static const std::vector<std::string> words = {
+            "crc ", "block ", "hamming ", "codeword ", "syndrome ", "parity ", "\n"};
+        std::string result;
+        while (result.size() < size)
+        {
+            state = state * 1664525 + 1013904223;
+            result += words[(state >> 24) % words.size()];
+        }
+        result.resize(size);
+        return result;
+    }
+
+    class Pipeline : public TempDirectory
+    {
+    };
+}
+
+TEST(SpscRing, TransfersBytesInOrder)
+{
+    //A ring much smaller than the data wraps around many times
+    const std::string data = text(100000, 1);
+    utils::SpscRing ring(64);
+
+    std::thread writer([&]()
+    {
+        utils::RingWriteBuffer buffer(ring, 100);
+        std::ostream out(&buffer);
+        for (std::size_t i = 0; i < data.size(); i += 777)
+            out.write(data.data() + i, std::min<std::size_t>(777, data.size() - i));
+        buffer.close();
+    });
+
+    utils::RingReadBuffer buffer(ring, 50);
+    std::istream in(&buffer);
+    const std::string received(std::istreambuf_iterator<char>(in), {});
+    writer.join();
+    EXPECT_EQ(received, data);
+}
+
+TEST_F(Pipeline, ProtectMatchesChainedStages)
+{
+    const std::string data = text(3000000, 2);
+    write(dir / "input", data);
+
+    pipeline::Options options;
+    options.crc.model = *crc::find_model("crc-32/iscsi");
+    options.ring_size = 1 << 12;
+    const auto crc = pipeline::protect(dir / "input", dir / "protected", options);
+
+    //The same stages one after another through whole buffers
+    std::istringstream input(data);
+    std::stringstream compressed;
+    encode_huffman(input, compressed, options.encode);
+    std::stringstream blocks;
+    EXPECT_EQ(crc::encode(compressed, blocks, options.crc), crc);
+    {
+        std::ofstream output(dir / "chained", std::ios::binary);
+        hamming::encode(blocks, output, options.hamming);
+    }
+    EXPECT_EQ(read<std::string>(dir / "protected"), read<std::string>(dir / "chained"));
+
+    std::ostringstream log;
+    const auto result = pipeline::restore(dir / "protected", dir / "restored", log);
+    EXPECT_EQ(result.crc, crc);
+    EXPECT_EQ(result.failed, 0u);
+    EXPECT_EQ(read<std::string>(dir / "restored"), data);
+}
+
+TEST_F(Pipeline, RestoreCorrectsBitErrors)
+{
+    const std::string data = text(500000, 3);
+    write(dir / "input", data);
+
+    pipeline::Options options;
+    options.compression = pipeline::Compression::FSE;
+    options.hamming = hamming::Type::SECDED_39_32;
+    pipeline::protect(dir / "input", dir / "protected", options);
+
+    //One flip every few codewords is corrected by the hamming stage
+    auto encoded = read<std::string>(dir / "protected");
+    for (std::size_t pos = 100; pos < encoded.size(); pos += 4999)
+        encoded[pos] ^= 0x20;
+    write(dir / "protected", encoded);
+
+    std::ostringstream log;
+    pipeline::RestoreOptions restore_options;
+    restore_options.hamming_threads = 2;
+    const auto result = pipeline::restore(dir / "protected", dir / "restored", log, restore_options);
+    EXPECT_EQ(result.failed, 0u);
+    EXPECT_EQ(read<std::string>(dir / "restored"), data);
+}
+
+TEST(PipelineRun, FailedStageStopsTheOthers)
+{
+    const std::string data = text(1 << 20, 4);
+    std::istringstream input(data);
+    std::ostringstream output;
+
+    //The middle stage gives up early, the first one must not block on
+    //its full ring and the last one sees the end of its input
+    std::vector<pipeline::Stage> stages = {
+        [](std::istream& in, std::ostream& out) { out << in.rdbuf(); },
+        [](std::istream& in, std::ostream&)
+        {
+            in.get();
+            throw std::invalid_argument("Stage failed");
+        },
+        [](std::istream& in, std::ostream& out) { out << in.rdbuf(); }};
+    EXPECT_THROW(pipeline::run(input, output, stages, 1 << 10), std::invalid_argument);
+}
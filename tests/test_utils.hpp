@@ -0,0 +1,60 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace tik
+{
+    namespace test
+    {
+        //Same bytes for a state on every platform
+        inline std::vector<char> random_bytes(std::size_t size, std::uint32_t state)
+        {
+            std::vector<char> result(size);
+            for (auto& c : result)
+            {
+                state = state * 1664525 + 1013904223;
+                c = static_cast<char>(state >> 24);
+            }
+            return result;
+        }
+
+        template <typename Container = std::vector<char>>
+        Container read(const std::filesystem::path& path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            return Container(std::istreambuf_iterator<char>(in), {});
+        }
+
+        template <typename Container>
+        void write(const std::filesystem::path& path, const Container& data)
+        {
+            std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+        }
+
+        //Every test gets an empty directory named after its suite and the
+        //process, so tests run by ctest side by side do not share files
+        class TempDirectory : public ::testing::Test
+        {
+        protected:
+            void SetUp() override
+            {
+                const std::string suite = ::testing::UnitTest::GetInstance()->current_test_info()->test_suite_name();
+                dir = std::filesystem::temp_directory_path() / ("tik_" + suite + "_" + std::to_string(::getpid()));
+                std::filesystem::create_directories(dir);
+            }
+
+            void TearDown() override
+            {
+                std::filesystem::remove_all(dir);
+            }
+
+            std::filesystem::path dir;
+        };
+    }
+}
@@ -0,0 +1,369 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "tik.hpp"
+#include "test_utils.hpp"
+
+using namespace tik;
+namespace fs = std::filesystem;
+
+namespace
+{
+    class TikFiles : public test::TempDirectory
+    {
+    protected:
+        fs::path write(const std::string& name, const std::string& content)
+        {
+            const auto path = dir / name;
+            test::write(path, content);
+            return path;
+        }
+
+        std::string read(const fs::path& path)
+        {
+            return test::read<std::string>(path);
+        }
+    };
+
+    std::string text_input(std::size_t size)
+    {
+        const std::string words[] = {"lorem ", "ipsum ", "dolor ", "sit ", "amet\n", "0123 "};
+        std::string input;
+        std::uint32_t state = 7;
+        while (input.size() < size)
+        {
+            state = state * 1664525 + 1013904223;
+            input += words[(state >> 24) % std::size(words)];
+        }
+        input.resize(size);
+        return input;
+    }
+}
+
+TEST_F(TikFiles, HuffmanRoundTrip)
+{
+    const std::string input = text_input(50000);
+    const auto from = write("input", input);
+    encode_huffman(from, dir / "encoded");
+    decode(dir / "encoded", dir / "decoded");
+    EXPECT_EQ(read(dir / "decoded"), input);
+}
+
+TEST_F(TikFiles, CanonicalRoundTrip)
+{
+    const std::string input = text_input(50000);
+    const auto from = write("input", input);
+
+    EncodeOptions options;
+    options.code_type = CodeTree::CodeType::CANONICAL;
+    encode_huffman(from, dir / "huffman", options);
+    encode_shannon_fano(from, dir / "shannon", options);
+    encode_huffman(from, dir / "arbitrary");
+
+    EXPECT_LT(fs::file_size(dir / "huffman"), fs::file_size(dir / "arbitrary"));
+
+    decode(dir / "huffman", dir / "huffman.decoded");
+    decode(dir / "shannon", dir / "shannon.decoded");
+    EXPECT_EQ(read(dir / "huffman.decoded"), input);
+    EXPECT_EQ(read(dir / "shannon.decoded"), input);
+}
+
+TEST_F(TikFiles, ChunkedRoundTrip)
+{
+    const std::string input = text_input(100000) + std::string(5000, 'x');
+    const auto from = write("input", input);
+
+    EncodeOptions options;
+    options.chunk_size = 4096;
+    options.threads = 4;
+    encode_huffman(from, dir / "huffman", options);
+    encode_shannon_fano(from, dir / "shannon", options);
+
+    decode(dir / "huffman", dir / "huffman.decoded", 4);
+    decode(dir / "shannon", dir / "shannon.decoded", 1);
+    EXPECT_EQ(read(dir / "huffman.decoded"), input);
+    EXPECT_EQ(read(dir / "shannon.decoded"), input);
+}
+
+TEST_F(TikFiles, ChunkedIsIndependentOfThreads)
+{
+    const std::string input = text_input(50000);
+    const auto from = write("input", input);
+
+    EncodeOptions options;
+    options.chunk_size = 1000;
+    options.threads = 1;
+    encode_huffman(from, dir / "single", options);
+    options.threads = 3;
+    encode_huffman(from, dir / "multi", options);
+
+    EXPECT_EQ(read(dir / "single"), read(dir / "multi"));
+}
+
+TEST_F(TikFiles, ChunkedEmpty)
+{
+    const auto from = write("input", "");
+
+    EncodeOptions options;
+    options.chunk_size = 1000;
+    encode_huffman(from, dir / "encoded", options);
+    decode(dir / "encoded", dir / "decoded");
+    EXPECT_EQ(read(dir / "decoded"), "");
+}
+
+TEST_F(TikFiles, EmptyRoundTrip)
+{
+    const auto from = write("input", "");
+
+    EncodeOptions canonical;
+    canonical.code_type = CodeTree::CodeType::CANONICAL;
+    for (const auto& options : {EncodeOptions(), canonical})
+    {
+        encode_huffman(from, dir / "huffman", options);
+        decode(dir / "huffman", dir / "decoded");
+        EXPECT_EQ(read(dir / "decoded"), "");
+
+        encode_shannon_fano(from, dir / "shannon_fano", options);
+        decode(dir / "shannon_fano", dir / "decoded");
+        EXPECT_EQ(read(dir / "decoded"), "");
+    }
+}
+
+TEST(Tik, StreamRoundTrip)
+{
+    const std::string input = text_input(100000);
+
+    EncodeOptions options;
+    options.chunk_size = 3000;
+    options.threads = 2;
+    std::istringstream in(input);
+    std::stringstream encoded;
+    encode_huffman(in, encoded, options);
+
+    std::ostringstream decoded;
+    decode(encoded, decoded, 2);
+    EXPECT_EQ(decoded.str(), input);
+}
+
+TEST(Tik, StreamRejectsOversizedWindow)
+{
+    std::istringstream in(text_input(5000));
+    std::ostringstream encoded;
+    encode_huffman(in, encoded);
+
+    //Magic and format, then chars, bits and the byte size of the window
+    std::string corrupt = encoded.str();
+    corrupt[4 + 3 * 8 - 3] = 0x10;
+    std::istringstream stream(corrupt);
+    std::ostringstream out;
+    EXPECT_THROW(decode(stream, out), std::invalid_argument);
+}
+
+TEST_F(TikFiles, StreamFileDecode)
+{
+    const std::string input = text_input(20000);
+    std::istringstream in(input);
+    std::ofstream encoded(dir / "encoded", std::ios::binary);
+    encode_shannon_fano(in, encoded);
+    encoded.close();
+
+    decode(dir / "encoded", dir / "decoded");
+    EXPECT_EQ(read(dir / "decoded"), input);
+}
+
+TEST_F(TikFiles, StreamRejectsChunked)
+{
+    const auto from = write("input", text_input(1000));
+    EncodeOptions options;
+    options.chunk_size = 100;
+    encode_huffman(from, dir / "encoded", options);
+
+    std::istringstream in(read(dir / "encoded"));
+    std::ostringstream out;
+    EXPECT_THROW(decode(in, out), std::invalid_argument);
+}
+
+TEST_F(TikFiles, InterleavedRoundTrip)
+{
+    EncodeOptions options;
+    options.interleaved = true;
+    for (const std::size_t size : {0, 1, 3, 5, 1000, 600001})
+    {
+        const std::string input = text_input(size);
+        const auto from = write("input", input);
+        encode_huffman(from, dir / "encoded", options);
+        decode(dir / "encoded", dir / "decoded");
+        EXPECT_EQ(read(dir / "decoded"), input);
+
+        std::istringstream in(read(dir / "encoded"));
+        std::ostringstream out;
+        decode(in, out);
+        EXPECT_EQ(out.str(), input);
+    }
+}
+
+TEST_F(TikFiles, FseRoundTrip)
+{
+    const std::string input = text_input(100000);
+    const auto from = write("input", input);
+
+    EncodeOptions options;
+    options.chunk_size = 30000;
+    options.threads = 2;
+    encode_fse(from, dir / "encoded", options);
+    decode(dir / "encoded", dir / "decoded", 2);
+    EXPECT_EQ(read(dir / "decoded"), input);
+
+    std::istringstream in(read(dir / "encoded"));
+    std::ostringstream out;
+    decode(in, out);
+    EXPECT_EQ(out.str(), input);
+}
+
+TEST_F(TikFiles, DecodeRangeReadsIndexedFiles)
+{
+    const std::string input = text_input(100000);
+    const auto from = write("input", input);
+
+    EncodeOptions seekable;
+    seekable.index_interval = 1000;
+    encode_huffman(from, dir / "seekable", seekable);
+    decode(dir / "seekable", dir / "decoded");
+    EXPECT_EQ(read(dir / "decoded"), input);
+
+    EncodeOptions chunked;
+    chunked.chunk_size = 3000;
+    encode_shannon_fano(from, dir / "chunked", chunked);
+
+    //Inside one interval, across boundaries and clamped at the end
+    const std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges = {
+        {0, 0}, {0, 10}, {999, 2}, {2999, 3002}, {50000, 30000}, {99990, 100}, {200000, 5}};
+    for (const auto& file : {dir / "seekable", dir / "chunked"})
+    {
+        for (const auto& [offset, length] : ranges)
+        {
+            std::ostringstream out;
+            const auto written = decode_range(file, out, offset, length);
+            const std::string expected = offset < input.size() ? input.substr(offset, length) : "";
+            EXPECT_EQ(written, expected.size()) << offset;
+            EXPECT_EQ(out.str(), expected) << offset;
+        }
+    }
+
+    encode_huffman(from, dir / "plain");
+    std::ostringstream out;
+    EXPECT_THROW(decode_range(dir / "plain", out, 0, 10), std::invalid_argument);
+
+    //A corrupt checkpoint count is rejected before it sizes anything
+    std::string corrupt = read(dir / "seekable");
+    std::uint64_t index_offset = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        index_offset |= std::uint64_t(static_cast<unsigned char>(corrupt[corrupt.size() - 8 + i])) << (i * 8);
+    corrupt[index_offset + 7] = 0x40;
+    EXPECT_THROW(decode_range(write("corrupt", corrupt), out, 0, 10), std::invalid_argument);
+}
+
+TEST(Tik, FseCompressorMatchesStreamFormat)
+{
+    FseCompressor compressor(30000);
+    FseDecompressor decompressor;
+    std::vector<std::byte> compressed;
+    std::vector<std::byte> decompressed;
+
+    //Buffers and tables are reused between inputs of different sizes
+    for (const std::size_t size : {100000, 0, 1, 29999, 60000})
+    {
+        const std::string input = text_input(size);
+        compressed.resize(compressor.max_compressed_size(size));
+        const auto used = compressor.compress(std::as_bytes(std::span(input)), compressed);
+
+        EncodeOptions options;
+        options.chunk_size = 30000;
+        std::istringstream in(input);
+        std::ostringstream out;
+        encode_fse(in, out, options);
+        const std::string expected = out.str();
+        ASSERT_TRUE(std::ranges::equal(std::span(compressed).first(used), std::as_bytes(std::span(expected))))
+            << size;
+
+        const auto encoded = std::span(compressed).first(used);
+        decompressed.resize(FseDecompressor::decompressed_size(encoded));
+        EXPECT_EQ(decompressor.decompress(encoded, decompressed), size);
+        EXPECT_TRUE(std::ranges::equal(decompressed, std::as_bytes(std::span(input)))) << size;
+    }
+
+    const std::string input = text_input(1000);
+    std::vector<std::byte> small(10);
+    EXPECT_THROW(compressor.compress(std::as_bytes(std::span(input)), small), std::invalid_argument);
+
+    //Huffman buffers go through HuffmanDecompressor
+    std::istringstream in(input);
+    std::ostringstream out;
+    encode_huffman(in, out);
+    const std::string huffman = out.str();
+    EXPECT_THROW(FseDecompressor::decompressed_size(std::as_bytes(std::span(huffman))), std::invalid_argument);
+}
+
+TEST_F(TikFiles, HuffmanCompressorMatchesFileFormat)
+{
+    for (const std::size_t chunk_size : {0, 3000})
+    {
+        HuffmanCompressor compressor(chunk_size);
+        HuffmanDecompressor decompressor;
+        std::vector<std::byte> compressed;
+        std::vector<std::byte> decompressed;
+
+        EncodeOptions options;
+        options.code_type = CodeTree::CodeType::CANONICAL;
+        options.chunk_size = chunk_size;
+        for (const std::size_t size : {50000, 0, 1, 2999, 3000, 7001})
+        {
+            const std::string input = size == 1 ? "x" : text_input(size);
+            encode_huffman(write("input", input), dir / "encoded", options);
+            const std::string expected = read(dir / "encoded");
+
+            compressed.resize(compressor.max_compressed_size(size));
+            const auto used = compressor.compress(std::as_bytes(std::span(input)), compressed);
+            const auto encoded = std::span(compressed).first(used);
+            ASSERT_TRUE(std::ranges::equal(encoded, std::as_bytes(std::span(expected))))
+                << chunk_size << " " << size;
+
+            decompressed.resize(HuffmanDecompressor::decompressed_size(encoded));
+            EXPECT_EQ(decompressor.decompress(encoded, decompressed), size);
+            EXPECT_TRUE(std::ranges::equal(decompressed, std::as_bytes(std::span(input)))) << size;
+        }
+    }
+
+    //Shannon-Fano files share the formats
+    const std::string input = text_input(10000);
+    EncodeOptions options;
+    options.code_type = CodeTree::CodeType::CANONICAL;
+    encode_shannon_fano(write("input", input), dir / "encoded", options);
+    const std::string shannon = read(dir / "encoded");
+    std::vector<std::byte> decompressed(input.size());
+    HuffmanDecompressor decompressor;
+    EXPECT_EQ(decompressor.decompress(std::as_bytes(std::span(shannon)), decompressed), input.size());
+    EXPECT_TRUE(std::ranges::equal(decompressed, std::as_bytes(std::span(input))));
+
+    //Arbitrary trees and truncated indexes are rejected
+    encode_huffman(dir / "input", dir / "arbitrary");
+    const std::string arbitrary = read(dir / "arbitrary");
+    EXPECT_THROW(HuffmanDecompressor::decompressed_size(std::as_bytes(std::span(arbitrary))),
+                 std::invalid_argument);
+
+    options.chunk_size = 3000;
+    encode_huffman(dir / "input", dir / "chunked", options);
+    const std::string chunked = read(dir / "chunked");
+    const auto truncated = std::as_bytes(std::span(chunked)).first(chunked.size() - 20);
+    EXPECT_THROW(decompressor.decompress(truncated, decompressed), std::invalid_argument);
+
+    HuffmanCompressor compressor;
+    std::vector<std::byte> small(10);
+    EXPECT_THROW(compressor.compress(std::as_bytes(std::span(input)), small), std::invalid_argument);
+}
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include "bit_writer.hpp"
+#include "histogram.hpp"
+#include "bit_buffer.hpp"
 #include <sstream>
 
 using namespace tik;
@@ -15,3 +17,64 @@ TEST(BitWriter, write)
     writer.write(std::bitset<3>(0b010));
     writer.write(std::bitset<3>(0b011));
 }
+
+TEST(Histogram, MatchesNaiveCount)
+{
+    std::string input(3 * (1 << 20) + 13, '\0');
+    std::uint32_t state = 1;
+    for (auto& c : input)
+    {
+        state = state * 1664525 + 1013904223;
+        c = static_cast<char>(state >> 24);
+    }
+    input.append(1000, 'q');
+
+    Histogram expected{};
+    for (const char c : input)
+        ++expected[static_cast<unsigned char>(c)];
+
+    EXPECT_EQ(histogram(input), expected);
+    EXPECT_EQ(histogram(input, 4), expected);
+    EXPECT_EQ(histogram(std::span(input.data(), 5), 4),
+              histogram(std::string_view(input.data(), 5)));
+}
+
+TEST(BufferBitWriter, MatchesBitWriter)
+{
+    std::vector<std::pair<std::uint64_t, unsigned>> values;
+    std::uint32_t state = 3;
+    for (unsigned i = 0; i < 5000; ++i)
+    {
+        state = state * 1664525 + 1013904223;
+        const unsigned length = state % 33;
+        values.push_back({(state >> 7) & ((std::uint64_t(1) << length) - 1), length});
+    }
+
+    std::ostringstream os;
+    {
+        BitWriter writer(os);
+        for (const auto& [value, length] : values)
+            writer.write(value, length);
+    }
+
+    std::vector<char> buffer(os.str().size());
+    BufferBitWriter writer(buffer);
+    for (const auto& [value, length] : values)
+        writer.write(value, length);
+    EXPECT_EQ(writer.finish(), buffer.size());
+    EXPECT_EQ(std::string(buffer.begin(), buffer.end()), os.str());
+
+    BufferBitReader reader(buffer);
+    for (const auto& [value, length] : values)
+        EXPECT_EQ(reader.read(length), value);
+    EXPECT_LE(reader.position(), reader.size());
+}
+
+TEST(BufferBitWriter, Overflow)
+{
+    std::vector<char> buffer(2);
+    BufferBitWriter writer(buffer);
+    writer.write(0xFFFF, 16);
+    writer.write(1, 1);
+    EXPECT_THROW(writer.finish(), std::out_of_range);
+}